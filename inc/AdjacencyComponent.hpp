@@ -16,12 +16,15 @@
 #include <utility>
 #include <limits>
 #include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
 
 #include "bdsg/internal/packed_structs.hpp"
 #include "handlegraph/handle_graph.hpp"
 #include "handlegraph/util.hpp"
 #include "handlegraph/types.hpp"
-#include "SubtractiveHandleGraph.hpp"
 #include "BipartiteGraph.hpp"
 #include "utility.hpp"
 
@@ -36,8 +39,9 @@ using handlegraph::HandleGraph;
 using handlegraph::handle_t;
 using std::sort;
 
-// forward declaration
+// forward declarations
 class AdjacencyComponent;
+class AdjacencyEdgeArray;
 
 // iterate over the adjacency components of a graph
 void for_each_adjacency_component(const HandleGraph& graph,
@@ -72,7 +76,13 @@ public:
     // - each edge in this adjacency component occurs in exactly one subgraph
     // - every subgraph is bipartite
     // - every subgraph is connected
-    void decompose_into_bipartite_blocks(const function<void(const BipartiteGraph&)>& lambda) const;
+    // non-bipartite parts of the component with at most max_exhaustive_size sides (capped at
+    // max_exhaustive_size_limit) are bipartitioned exactly, larger ones with a local search heuristic.
+    // larger ones use the best of num_cut_starts local searches, run on num_threads threads
+    void decompose_into_bipartite_blocks(const function<void(const BipartiteGraph&)>& lambda,
+                                         size_t max_exhaustive_size = default_max_exhaustive_size,
+                                         size_t num_cut_starts = default_num_cut_starts,
+                                         size_t num_threads = 1) const;
     
     
     
@@ -93,11 +103,13 @@ public:
     // returns empty sets if the adjacency component is not actually bipartite
     bipartition bipartite_partition() const;
     
-    // return the maximum bipartite partition computed in O(Delta * 2^(n-1)) time
+    // return the maximum bipartite partition computed in O(2^(n-1)) time using bit-parallel
+    // adjacency sets. this is only practical for small components, so components with more
+    // than max_exhaustive_size_limit sides are rejected.
     bipartition exhaustive_maximum_bipartite_partition() const;
     
     // return a expected 1/2-approximation of the maximum bipartite partition
-    bipartition maximum_bipartite_partition_apx_1_2(uint64_t seed = 8477176661834875934ull) const;
+    bipartition maximum_bipartite_partition_apx_1_2(uint64_t seed = default_apx_seed) const;
     
     // greedily modify a bipartite partition until it is locally optimal.
     // uses Bylka, Idzik, & Tuza's (1999) iteration scheme to guarantee Edwards-Erdos
@@ -105,13 +117,58 @@ public:
     void refine_apx_partition(bipartition& partition,
                               size_t max_opt_steps = numeric_limits<size_t>::max()) const;
     
+    // do several randomized 1/2-approximations followed by local refinement, and return
+    // the best result. the seeds are derived from the component, and the result does not
+    // depend on the number of threads.
+    bipartition multi_start_maximum_bipartite_partition(size_t num_starts, size_t num_threads = 1,
+                                                        size_t max_opt_steps = numeric_limits<size_t>::max()) const;
+    
     // TODO: include Goemans-Williamson SDP algorithm with .88 approx ratio?
     
+    static constexpr size_t default_max_exhaustive_size = 20;
+    // the exhaustive search takes 2^(n-1) steps, so it is only allowed up to 30 sides, and it
+    // is slow enough to warn about above 24
+    static constexpr size_t max_exhaustive_size_limit = 30;
+    static constexpr size_t slow_exhaustive_size = 24;
+    static constexpr size_t default_num_cut_starts = 8;
+    
 private:
     
-    // use a recursively defined Gray code to iterate over all bipartitions
-    uint64_t recursive_gray_code(bipartition& partition, uint64_t score, size_t index, size_t to_flip,
-                                 uint64_t& best_score, uint64_t& best_index) const;
+    static constexpr uint64_t default_apx_seed = 8477176661834875934ull;
+    
+    /*
+     * Index-based implementations of the algorithms above. They operate on the sides in
+     * "active" (indexes into the edge array, in sorted order) and ignore removed edges.
+     * The side assignments are recorded in "on_left", which is indexed by side.
+     */
+    
+    // returns false if the active sides are not connected and bipartite
+    bool bipartite_partition(const AdjacencyEdgeArray& edges, const vector<size_t>& active,
+                             vector<bool>& on_left) const;
+    
+    void exhaustive_maximum_bipartite_partition(const AdjacencyEdgeArray& edges,
+                                                const vector<size_t>& active,
+                                                vector<bool>& on_left) const;
+    
+    void maximum_bipartite_partition_apx_1_2(const AdjacencyEdgeArray& edges,
+                                             const vector<size_t>& active,
+                                             vector<bool>& on_left, uint64_t seed) const;
+    
+    void refine_apx_partition(const AdjacencyEdgeArray& edges, const vector<size_t>& active,
+                              vector<bool>& on_left, size_t max_opt_steps) const;
+    
+    void multi_start_maximum_bipartite_partition(const AdjacencyEdgeArray& edges,
+                                                 const vector<size_t>& active,
+                                                 vector<bool>& on_left, size_t max_opt_steps,
+                                                 size_t num_starts, size_t num_threads) const;
+    
+    // the number of edges across the partition
+    size_t cut_size(const AdjacencyEdgeArray& edges, const vector<size_t>& active,
+                    const vector<bool>& on_left) const;
+    
+    // convert between the index-based and handle-based representations of a partition
+    bipartition to_bipartition(const vector<size_t>& active, const vector<bool>& on_left) const;
+    void from_bipartition(const bipartition& partition, vector<bool>& on_left) const;
     
     vector<handle_t> component;
     
@@ -124,7 +181,64 @@ private:
 
 
 
-/// Template implementations
+/*
+ * A compact copy of the edges of an adjacency component in which the sides are
+ * referred to by their index in the (sorted) component. Edges can be removed by
+ * setting a bit, which lets us peel off bipartite blocks without building any
+ * overlay graphs.
+ */
+class AdjacencyEdgeArray {
+public:
+    AdjacencyEdgeArray(const HandleGraph& graph, const vector<handle_t>& sides);
+    
+    size_t num_sides() const;
+    size_t num_edges() const;
+    
+    // the side at an index
+    handle_t get_side(size_t i) const;
+    
+    // execute a lambda on the index of each adjacent side and the ID of the edge
+    // connecting to it, in the same order as HandleGraph::follow_edges. removed
+    // edges are skipped.
+    template<typename Lambda>
+    void for_each_edge(size_t i, const Lambda& lambda) const;
+    
+    void remove_edge(size_t edge_id);
+    bool is_removed(size_t edge_id) const;
+    
+private:
+    
+    vector<handle_t> sides;
+    // CSR adjacency lists, with the edge IDs stored in parallel to the adjacent sides
+    vector<size_t> offsets;
+    vector<size_t> adjacent_sides;
+    vector<size_t> edge_ids;
+    size_t edge_count = 0;
+    // bitmask of removed edges
+    vector<uint64_t> removed;
+};
+
+
+
+
+/// Template and inline implementations
+
+template<typename Lambda>
+void AdjacencyEdgeArray::for_each_edge(size_t i, const Lambda& lambda) const {
+    for (size_t k = offsets[i], end = offsets[i + 1]; k < end; ++k) {
+        if (!is_removed(edge_ids[k])) {
+            lambda(adjacent_sides[k], edge_ids[k]);
+        }
+    }
+}
+
+inline bool AdjacencyEdgeArray::is_removed(size_t edge_id) const {
+    return removed[edge_id / 64] & (uint64_t(1) << (edge_id % 64));
+}
+
+inline void AdjacencyEdgeArray::remove_edge(size_t edge_id) {
+    removed[edge_id / 64] |= (uint64_t(1) << (edge_id % 64));
+}
 
 template<typename SideIter>
 AdjacencyComponent::AdjacencyComponent(const HandleGraph& graph,
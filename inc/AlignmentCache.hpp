@@ -0,0 +1,206 @@
+#ifndef BLUNTIFIER_ALIGNMENTCACHE_HPP
+#define BLUNTIFIER_ALIGNMENTCACHE_HPP
+
+#include "Subgraph.hpp"
+#include "OverlapAligner.hpp"
+
+#include "utility.hpp"
+
+#include <unordered_map>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <list>
+#include <map>
+
+using std::unordered_map;
+using std::string;
+using std::vector;
+using std::pair;
+using std::mutex;
+using std::list;
+using std::multimap;
+using handlegraph::nid_t;
+
+
+namespace bluntifier {
+
+
+// The aligned graph for a list of sequences, independent of the handles and path names that it was built for
+class SubgraphTemplate{
+public:
+    /// Attributes ///
+    // Node IDs are kept so that an instantiated subgraph is identical to the original one
+    vector <nid_t> node_ids;
+    vector <string> node_sequences;
+
+    // Handles are stored as 2*node_index + is_reverse
+    vector <pair <uint64_t, uint64_t> > edges;
+
+    // The steps of the path for each sequence, indexed like the sequences that were aligned
+    vector <vector <uint64_t> > paths;
+
+    /// Methods ///
+    SubgraphTemplate()=default;
+
+    // Record the graph and the path of each sequence (as given by the spoa_id of each PathInfo)
+    explicit SubgraphTemplate(const Subgraph& subgraph);
+
+    // Align the sequences and record the result
+    SubgraphTemplate(OverlapAligner& overlap_aligner, const vector<string>& sequences);
+
+    // Build the graph in a subgraph whose paths have been created but are empty, using the spoa_id of each PathInfo
+    // to find its steps
+    void instantiate(Subgraph& subgraph) const;
+
+    // Approximate number of bytes used
+    uint64_t get_size() const;
+
+    // Check that the template is internally consistent and that its paths spell these sequences, so that it can
+    // safely be instantiated for them
+    bool is_valid_for(const vector<string>& sequences) const;
+
+    // Append a binary representation to the buffer
+    void serialize(string& buffer) const;
+
+    // Parse a binary representation, returning false if it is malformed
+    bool deserialize(const char* data, size_t size);
+};
+
+
+// Remembers the result of aligning each list of sequences, so that bicliques with identical sequences (e.g. from
+// segmental duplications or unresolved repeats) are only aligned once. Results are kept in memory up to a size limit,
+// dropping the least recently used ones. Optionally, they are also kept in a directory so that they can be reused by
+// later runs on similar graphs.
+class AlignmentCache{
+private:
+    /// Attributes ///
+    class Entry{
+    public:
+        // Only the aligner description is kept to check the key, the sequences are checked against the template
+        string aligner_description;
+        SubgraphTemplate subgraph_template;
+        uint64_t size;
+
+        // Entries that were stored ahead of time are not evicted until they have been loaded once, or until the
+        // point where they were expected to be used has passed. Only unpinned entries have a position in the LRU order
+        bool is_pinned;
+        list <pair <uint64_t, uint64_t> >::iterator lru_position;
+        multimap <size_t, pair <uint64_t, uint64_t> >::iterator pin_position;
+    };
+
+    // Keyed by a 128 bit hash of the full key
+    unordered_map <pair <uint64_t, uint64_t>, Entry> entries;
+
+    // Most recently used first
+    list <pair <uint64_t, uint64_t> > lru_order;
+
+    // Pinned entries, by the position after which they are not expected to be used anymore
+    multimap <size_t, pair <uint64_t, uint64_t> > pin_order;
+
+    uint64_t memory_bytes = 0;
+    uint64_t peak_memory_bytes = 0;
+    uint64_t pinned_bytes = 0;
+    uint64_t max_memory_bytes = default_max_memory_bytes;
+    mutex cache_mutex;
+
+    // Empty if results are only kept in memory
+    string directory;
+    uint64_t max_directory_bytes = default_max_directory_bytes;
+
+    uint64_t n_hits = 0;
+    uint64_t n_disk_hits = 0;
+    uint64_t n_pinned_hits = 0;
+    uint64_t n_bases_avoided = 0;
+
+    // The aligner description is part of the key because different aligners (or parameters) can produce different
+    // graphs for the same input. So is the order of the sequences, since POA results depend on it
+    static string make_key(const string& aligner_description, const vector<string>& sequences);
+
+    static pair <uint64_t, uint64_t> hash_key(const string& key);
+
+    // Content address of a key in the directory
+    string get_entry_path(const pair <uint64_t, uint64_t>& key_hash) const;
+
+    bool load_from_directory(
+            const string& key,
+            const pair <uint64_t, uint64_t>& key_hash,
+            const vector<string>& sequences,
+            SubgraphTemplate& subgraph_template);
+
+    void store_in_directory(
+            const string& key,
+            const pair <uint64_t, uint64_t>& key_hash,
+            const SubgraphTemplate& subgraph_template);
+
+    // Add an entry to memory, dropping unpinned entries until it fits. Returns false if it still doesn't fit. Must be
+    // called with the mutex held
+    bool store_in_memory(
+            const pair <uint64_t, uint64_t>& key_hash,
+            const string& aligner_description,
+            SubgraphTemplate&& subgraph_template,
+            bool is_pinned,
+            size_t pinned_until);
+
+    // Move a pinned entry into the LRU order, at the front if it is being used. Must be called with the mutex held
+    void unpin_entry(const pair <uint64_t, uint64_t>& key_hash, Entry& entry, bool is_used);
+
+public:
+    /// Attributes ///
+    static constexpr uint64_t default_max_directory_bytes = 4ull*1024*1024*1024;
+    static constexpr uint64_t default_max_memory_bytes = 256ull*1024*1024;
+
+    /// Methods ///
+
+    // Also look for results in this directory and write new ones to it. The directory is created if it doesn't exist
+    void open_directory(const string& directory, uint64_t max_directory_bytes = default_max_directory_bytes);
+
+    void set_max_memory_bytes(uint64_t max_memory_bytes);
+
+    // If these sequences have been aligned already, build their graph in the subgraph (whose paths must be empty,
+    // with the spoa_id of each PathInfo being the index of an original sequence) and return true
+    bool load(const string& aligner_description, const vector<string>& sequences, Subgraph& subgraph);
+
+    // Check whether these sequences have been aligned already (in memory or in the directory), without loading them
+    bool contains(const string& aligner_description, const vector<string>& sequences);
+
+    // Record the alignment of the sequences. Pinned entries are kept until they are loaded, for results that
+    // are computed before they are needed, or until unpin() is called with a position past pinned_until. Returns false
+    // if the entry could not be kept in memory
+    bool store(
+            const string& aligner_description,
+            const vector<string>& sequences,
+            SubgraphTemplate subgraph_template,
+            bool is_pinned = false,
+            size_t pinned_until = 0);
+
+    // Make the pinned entries that were expected to be used before this position evictable, since they won't be (e.g.
+    // because they were computed for sequences that were predicted wrong)
+    void unpin(size_t position);
+
+    // Whether more entries can be pinned without going over the memory limit
+    bool has_room();
+
+    // Delete the least recently used entries in the directory until it fits within its size limit
+    void evict();
+
+    // Align these sequences unless they already have been, and build their graph in the subgraph like load() does.
+    // Returns true if the alignment was reused
+    bool align(OverlapAligner& overlap_aligner, const vector<string>& sequences, Subgraph& subgraph);
+
+    uint64_t get_n_hits() const;
+    uint64_t get_n_disk_hits() const;
+
+    // Loads of pinned entries, which are not included in the number of hits
+    uint64_t get_n_pinned_hits() const;
+    uint64_t get_n_bases_avoided() const;
+    uint64_t get_memory_bytes() const;
+    uint64_t get_peak_memory_bytes() const;
+};
+
+
+}
+
+#endif //BLUNTIFIER_ALIGNMENTCACHE_HPP
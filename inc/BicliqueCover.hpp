@@ -39,8 +39,9 @@ public:
     
     // initialize with a graph and partition of node sides. the
     // subgraph induced by the partition must be bipartite to be
-    // valid (this is not checked)
-    BicliqueCover(const BipartiteGraph& graph);
+    // valid (this is not checked). large domino-free graphs can use
+    // multiple threads.
+    BicliqueCover(const BipartiteGraph& graph, size_t num_threads = 1);
     ~BicliqueCover();
     
     // compute and return a biclique cover of the partition, where
@@ -65,6 +66,8 @@ protected:
     
     const BipartiteGraph& graph;
     
+    size_t num_threads;
+    
 };
 
 }
@@ -44,6 +44,12 @@ public:
     BipartiteGraph(const HandleGraph& graph,
                    const bipartition& partition);
     
+    // construct from sorted partitions and adjacency lists from the index of each left side
+    // to the indexes of its adjacent right sides, rather than from the graph's edges
+    BipartiteGraph(const HandleGraph& graph,
+                   const ordered_bipartition& partition,
+                   const vector<vector<size_t>>& left_edges);
+    
     ~BipartiteGraph();
     
     size_t get_degree(handle_t node) const;
@@ -68,8 +74,8 @@ public:
     const HandleGraph& get_graph() const;
 private:
     
-    BipartiteGraph(const HandleGraph& graph,
-                   const ordered_bipartition& partition);
+    // build the index maps and the right side adjacency lists
+    void index_partition();
     
     // Amilhastre algorithm
     void simplify_side(const vector<handle_t>& simplifying_partition,
@@ -9,15 +9,16 @@
 #include "Subgraph.hpp"
 #include "OverlappingOverlap.hpp"
 #include "OverlappingOverlapSplicer.hpp"
+#include "OverlapAligner.hpp"
+#include "AlignmentCache.hpp"
 #include "gfa_to_handle.hpp"
 #include "utility.hpp"
 #include "unchop.hpp"
 
-#include "spoa/alignment_engine.hpp"
-#include "spoa/graph.hpp"
-
 #include <unordered_map>
 #include <ctime>
+#include <thread>
+#include <atomic>
 
 #include "bdsg/hash_graph.hpp"
 
@@ -26,9 +27,7 @@ using handlegraph::MutablePathDeletableHandleGraph;
 using handlegraph::as_integer;
 using handlegraph::handle_t;
 using bdsg::HashGraph;
-using spoa::AlignmentEngine;
-using spoa::AlignmentType;
-using spoa::Graph;
+using std::thread;
 
 
 namespace bluntifier {
@@ -43,14 +42,37 @@ public:
 };
 
 
+// Overlap sequences of a biclique that are aligned in the background, with the aligner that it is expected to use
+class Prealignment{
+public:
+    size_t biclique_index;
+    OverlapAligner* overlap_aligner;
+    vector <string> sequences;
+
+    Prealignment(size_t biclique_index, OverlapAligner* overlap_aligner, vector<string>&& sequences);
+};
+
+
 class Bluntifier {
 private:
     /// Attributes ///
     string gfa_path;
     string provenance_path;
     bool verbose;
+    size_t max_exhaustive_size;
+    size_t num_cut_starts;
+    size_t n_threads;
+    string aligner_name;
     time_t time_start;
 
+    // Aligners are shared by all the bicliques so that they can collect statistics
+    unique_ptr<SpoaAligner> spoa_aligner;
+    unique_ptr<WavefrontAligner> wavefront_aligner;
+
+    // Overlaps at least this long are partial order aligned in windows, or never if it is 0
+    size_t min_windowed_overlap_length;
+    unique_ptr<WindowedAligner> windowed_aligner;
+
     HashGraph gfa_graph;
     IncrementalIdMap<string> id_map;
     OverlapMap overlaps;
@@ -63,26 +85,64 @@ private:
     vector <vector <BicliqueEdgeIndex> > node_to_biclique_edge;
 
     // Store the mapping from children to parent, and a boolean to tell whether that child is a suffix/prefix or the
-    // original node material
-    map <nid_t, pair<nid_t, bool> > child_to_parent;
-    map <nid_t, set<nid_t> > parent_to_children;
+    // original node material, as well as the children of each parent
+    Parentage parentage;
+
+    // Subgraphs are spliced as soon as they are aligned. Only the bicliques that meet at overlapping overlap nodes keep
+    // anything afterwards: the names of their paths, for the OverlappingOverlapSplicer
+    vector <SplicedPaths> spliced_paths;
+
+    // Overlap CIGARs with more mismatching M columns than this are not trusted to build a subgraph, POA is used instead
+    static constexpr double max_cigar_mismatch_fraction = 0.25;
+
+    // Bicliques are aligned and spliced in batches of this many, which bounds the number of subgraphs held at once
+    static constexpr size_t splice_batch_size = 4096;
+    AlignmentCache alignment_cache;
 
-    vector <Subgraph> subgraphs;
-    map <nid_t, OverlappingNodeInfo> overlapping_overlap_nodes;
+    // Overlap sequences that are aligned in the background while node termini are duplicated. The results are picked
+    // up through the alignment cache, and unpinned from it once their biclique has been aligned. Each one's sequences are
+    // freed once it is aligned, and the rest once the workers have joined
+    vector <Prealignment> prealignments;
+    atomic <size_t> next_prealignment{0};
+    atomic <uint64_t> n_prealigned{0};
+    OverlappingOverlapNodes overlapping_overlap_nodes;
+    OverlappingOverlapIndex overlapping_overlap_index;
 
     // Child node -> start_index -> (parent_node, stop_index)
     unordered_map<nid_t, multimap <nid_t, ProvenanceInfo> > provenance_map;
 
-    unordered_set <nid_t> to_be_destroyed;
+    // Termini that were replaced by their paths in the POA subgraphs, indexed by node ID. They are left out of the
+    // output and the provenance, rather than being destroyed from the graph one at a time
+    vector <bool> dropped_nodes;
 
 public:
     /// Methods ///
     Bluntifier(const string& gfa_path,
                const string& provenance_path,
-               bool verbose);
+               bool verbose,
+               size_t max_exhaustive_size = AdjacencyComponent::default_max_exhaustive_size,
+               size_t num_cut_starts = AdjacencyComponent::default_num_cut_starts,
+               size_t n_threads = 1,
+               const string& aligner_name = "spoa",
+               bool adaptive_poa = false,
+               size_t min_windowed_overlap_length = WindowedAligner::default_min_overlap_length,
+               const string& align_cache_directory = "",
+               uint64_t align_cache_max_bytes = AlignmentCache::default_max_directory_bytes);
 
     void bluntify();
 
+    // The first half of bluntify: read the GFA, cover the overlaps with bicliques, and duplicate the node termini so
+    // that each biclique has its own. Afterwards the graph and the parentage of its nodes can be inspected
+    void duplicate_termini();
+
+    const HashGraph& get_graph() const;
+    const Parentage& get_parentage() const;
+    const OverlappingOverlapNodes& get_overlapping_overlap_nodes() const;
+    const AlignmentCache& get_alignment_cache() const;
+
+    // Number of bicliques that were aligned in the background while the termini were duplicated
+    uint64_t get_n_prealigned() const;
+
     void write_provenance();
 
 private:
@@ -96,24 +156,50 @@ private:
 
     void map_splice_sites_by_node();
 
+    // A node is identified by its ID and whether the overlap is at the end of its forward strand, given the side of the
+    // edge that its handle is on
+    pair <nid_t, bool> get_node_side(const handle_t& h, size_t side) const;
+
+    // The edges of a biclique, reoriented so that each node side is traversed in the same orientation by all of them
+    vector <edge_t> get_harmonized_edges(const vector<edge_t>& edges) const;
+
     void harmonize_biclique_orientations();
 
-    void align_biclique_overlaps(size_t i);
+    CompactSubgraph align_biclique_overlaps(size_t i);
+
+    // Choose how to align a biclique that needs POA (or an alternative to it)
+    OverlapAligner* select_overlap_aligner(size_t i, const vector<string>& sequences);
+
+    // Find the sequences that align_biclique_overlaps will give to an aligner once node termini are duplicated, using
+    // the original graph. Returns false if the biclique is not expected to need an aligner
+    bool predict_overlap_sequences(size_t i, vector<string>& sequences);
+
+    // Start aligning the predicted overlap sequences on n_threads threads, which must be joined before the termini
+    // are used in align_biclique_overlaps
+    void start_prealignment(vector<thread>& workers);
+
+    void prealign_overlaps();
 
     bool biclique_overlaps_are_exact(size_t i);
 
-    void create_exact_subgraph(size_t i);
+    void create_exact_subgraph(size_t i, Subgraph& subgraph);
+
+    // Build the subgraph of a 1x1 or 1xN biclique directly from the overlap CIGARs, returns false (without
+    // modifying the subgraph) if the biclique doesn't have this shape or the CIGARs can't be trusted
+    bool create_subgraph_from_cigars(size_t i, Subgraph& subgraph);
 
-    void add_alignments_to_poa(
-            Graph& spoa_graph,
-            unique_ptr<AlignmentEngine>& alignment_engine,
-            size_t i);
+    // Fraction of the aligned bases in a biclique's overlap CIGARs that are mismatches or indels
+    double estimate_overlap_divergence(size_t i);
 
-    void convert_spoa_to_bdsg(Graph& spoa_graph, size_t i);
+    // Insert aligned subgraphs into gfa_graph (in order) and connect the ends of their paths to the parents of the
+    // termini. All the nodes are created first, with ID ranges that are reserved up front
+    void splice_subgraphs(const vector<CompactSubgraph>& subgraphs);
 
-    void splice_subgraphs();
+    // Flag the bicliques that have a child in an overlapping overlap node
+    vector <bool> find_overlapping_overlap_bicliques() const;
 
-    tuple <bool, bool> is_oo_node(nid_t node_id);
+    void drop_node(nid_t node_id);
+    bool is_dropped(nid_t node_id) const;
 
     void compute_provenance();
 
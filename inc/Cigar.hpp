@@ -47,7 +47,9 @@ public:
 
     /// Methods ///
     AlignmentIterator();
-    AlignmentIterator(uint64_t query_index, uint64_t ref_index);
+
+    // The reference index comes first, unlike in the attributes above
+    AlignmentIterator(uint64_t ref_index, uint64_t query_index);
     void next_cigar();
 };
 
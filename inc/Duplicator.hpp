@@ -30,10 +30,9 @@ public:
     OverlapMap& overlaps;
     Bicliques& bicliques;
 
-    map <nid_t, set<nid_t> >& parent_to_children;
-    map <nid_t, pair<nid_t, bool> >& child_to_parent;
+    Parentage& parentage;
 
-    map<nid_t, OverlappingNodeInfo>& overlapping_overlap_nodes;
+    OverlappingOverlapNodes& overlapping_overlap_nodes;
 
 
     /// Methods ///
@@ -41,9 +40,8 @@ public:
             const vector <vector <BicliqueEdgeIndex> >& node_to_biclique_edge,
             OverlapMap& overlaps,
             Bicliques& bicliques,
-            map <nid_t, set<nid_t> >& parent_to_children,
-            map <nid_t, pair<nid_t, bool> >& child_to_parent,
-            map <nid_t, OverlappingNodeInfo>& overlapping_overlap_nodes);
+            Parentage& parentage,
+            OverlappingOverlapNodes& overlapping_overlap_nodes);
 
     void duplicate_all_node_termini(MutablePathDeletableHandleGraph& gfa_graph);
 
@@ -66,7 +64,7 @@ private:
             array<map<size_t, handle_t>, 2>& biclique_side_to_child,
             const NodeInfo& node_info);
 
-    map<nid_t, OverlappingNodeInfo>::iterator preprocess_overlapping_overlaps(
+    OverlappingNodeInfo& preprocess_overlapping_overlaps(
             MutablePathDeletableHandleGraph& gfa_graph,
             array <deque <size_t>, 2>& sorted_sizes_per_side,
             array <deque <size_t>, 2>& sorted_bicliques_per_side,
@@ -75,7 +73,7 @@ private:
 
     void postprocess_overlapping_overlap(
             const HandleGraph& gfa_graph,
-            map<nid_t, OverlappingNodeInfo>::iterator iter,
+            OverlappingNodeInfo& overlapping_node_info,
             array<map<size_t, handle_t>, 2> biclique_side_to_child);
 
     bool contains_overlapping_overlaps(
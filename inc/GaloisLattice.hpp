@@ -13,6 +13,9 @@
 #include <unordered_set>
 #include <algorithm>
 #include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
 
 #include "handlegraph/handle_graph.hpp"
 #include "handlegraph/types.hpp"
@@ -34,8 +37,11 @@ class CenteredGaloisTree;
  */
 class GaloisLattice {
 public:
-    // construct with algorithm 4 and 5 from Amilhastre, et al. (1998)
-    GaloisLattice(const BipartiteGraph& graph);
+    // construct with algorithm 4 and 5 from Amilhastre, et al. (1998). the centered
+    // Galois trees are built on num_threads threads if the graph has at least
+    // min_parallel_size left nodes (the result does not depend on either)
+    GaloisLattice(const BipartiteGraph& graph, size_t num_threads = 1,
+                  size_t min_parallel_size = default_min_parallel_size);
     ~GaloisLattice() = default;
     
     // return true if the bipartite graph given to the constructor is
@@ -45,8 +51,14 @@ public:
     // if the graph is domino-free and simple, returns the biclique cover
     vector<bipartition> biclique_separator() const;
     
+    static constexpr size_t default_min_parallel_size = 256;
+    
 private:
     
+    // build the centered Galois tree of each left node, returns false if any
+    // of them lack the neighbor ordering property
+    bool build_galois_trees(const BipartiteGraph& graph, size_t num_threads);
+    
     // clear to mark graph as not domino-free
     void clear();
     
@@ -76,6 +88,8 @@ public:
     // Amilhastre, et al (1998) algorithm 3
     CenteredGaloisTree(const BipartiteGraph& cover, handle_t center);
     CenteredGaloisTree() = delete;
+    CenteredGaloisTree(const CenteredGaloisTree& other) = default;
+    CenteredGaloisTree(CenteredGaloisTree&& other) = default;
     ~CenteredGaloisTree() = default;
     
     // true if this tree is consistent with a domino-free graph
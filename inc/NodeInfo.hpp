@@ -4,6 +4,7 @@
 #include "BicliqueCover.hpp"
 #include "Biclique.hpp"
 #include "OverlapMap.hpp"
+#include "Parentage.hpp"
 #include "gfa_to_handle.hpp"
 #include "handle_to_gfa.hpp"
 #include "duplicate_terminus.hpp"
@@ -46,14 +47,14 @@ public:
 
     NodeInfo(
             const vector<vector<BicliqueEdgeIndex> >& node_to_biclique_edge,
-            const map <nid_t, pair<nid_t, bool> >& child_to_parent,
+            const Parentage& parentage,
             const Bicliques& bicliques,
             const HandleGraph& gfa_graph,
             const OverlapMap& overlaps,
             nid_t node_id);
 
     void factor_overlaps_by_biclique_and_side();
-    void factor_overlaps_by_biclique_and_side(const map <nid_t, pair<nid_t, bool> >& child_to_parent);
+    void factor_overlaps_by_biclique_and_side(const Parentage& parentage);
 
     void sort_factored_overlaps();
 
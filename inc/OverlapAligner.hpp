@@ -0,0 +1,296 @@
+#ifndef BLUNTIFIER_OVERLAPALIGNER_HPP
+#define BLUNTIFIER_OVERLAPALIGNER_HPP
+
+#include "Subgraph.hpp"
+#include "Cigar.hpp"
+
+#include "spoa/alignment_engine.hpp"
+#include "spoa/graph.hpp"
+
+#include "bdsg/hash_graph.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <tuple>
+#include <map>
+#include <atomic>
+#include <cstdint>
+
+using bdsg::HashGraph;
+using handlegraph::handle_t;
+using handlegraph::path_handle_t;
+using spoa::AlignmentEngine;
+using spoa::AlignmentType;
+using spoa::Graph;
+
+using std::unique_ptr;
+using std::string;
+using std::vector;
+using std::pair;
+using std::tuple;
+using std::map;
+using std::atomic;
+
+
+namespace bluntifier {
+
+
+// Incrementally builds a graph from sequences that are each aligned to the same backbone sequence. Bases that match
+// the backbone share its nodes, and bases that differ from it in the same way at the same position share a node
+class BackboneGraph{
+private:
+    /// Attributes ///
+    const string& backbone_sequence;
+    HashGraph& graph;
+
+    // One node per base of the backbone (to be unchopped later)
+    vector<handle_t> backbone;
+
+    // Keyed by (backbone index, offset into an insertion before that index or 0 for a mismatch, base)
+    map <tuple <size_t, size_t, char>, handle_t> variant_nodes;
+
+public:
+    /// Methods ///
+    BackboneGraph(const string& backbone_sequence, HashGraph& graph);
+
+    // Thread a path that spells the whole backbone
+    void add_backbone_path(const path_handle_t& path);
+
+    // Thread a path that spells the sequence, given its alignment to the backbone (as the ref) starting at backbone
+    // index backbone_start. Only M, =, X, I and D operations are allowed
+    void add_path(
+            const path_handle_t& path,
+            const string& sequence,
+            const vector<Cigar>& operations,
+            size_t backbone_start);
+};
+
+
+// Builds the blunt subgraph for the overlap sequences of a biclique. Before aligning, the subgraph must contain one
+// empty path per sequence, with the index of its sequence stored in the spoa_id of its PathInfo. Afterwards, each path
+// spells its sequence
+class OverlapAligner{
+public:
+    /// Methods ///
+    virtual ~OverlapAligner() = default;
+
+    // Exact flanks that all the sequences share are not given to align_divergent, they are added back as shared nodes
+    void align(const vector<string>& sequences, Subgraph& subgraph);
+
+    // Identifies the algorithm and its parameters, so that cached results are only reused if they would be reproduced
+    virtual string describe() const = 0;
+
+    // Find the longest prefix and suffix shared exactly by all the sequences, leaving at least one base of each
+    // sequence in between them
+    static pair<size_t, size_t> find_shared_flanks(const vector<string>& sequences);
+
+protected:
+    // Build the graph for the sequences by appending steps to their (possibly non-empty) paths
+    virtual void align_divergent(const vector<string>& sequences, Subgraph& subgraph) = 0;
+
+    // For aligners that hand the sequences they can't handle over to another one
+    static void delegate_divergent(OverlapAligner& aligner, const vector<string>& sequences, Subgraph& subgraph);
+};
+
+
+// Two rounds of partial order alignment, the second one seeded with the consensus of the first. Sequences are added in
+// a guide order, so that each one is aligned to a graph that already contains its most similar sequence. In adaptive
+// mode, the second round is skipped when all the sequences are within max_single_pass_divergence edits per base of the
+// first round's consensus. For bicliques with at least min_frozen_sequences distinct sequences, the second round aligns
+// them all concurrently to the seeded graph before adding any of them
+class SpoaAligner: public OverlapAligner{
+private:
+    /// Attributes ///
+    bool adaptive;
+    double max_single_pass_divergence;
+    size_t n_threads;
+    size_t min_frozen_sequences;
+
+    // Shared by all the bicliques aligned with this aligner
+    atomic <uint64_t> n_single_pass{0};
+    atomic <uint64_t> n_two_pass{0};
+    atomic <uint64_t> nanoseconds_saved{0};
+    atomic <uint64_t> n_poa_nodes{0};
+    atomic <uint64_t> n_frozen{0};
+
+public:
+    static constexpr double default_max_single_pass_divergence = 0.01;
+
+    // Below this, the DP for the second round is cheap enough that it is better to let each sequence see the ones
+    // before it
+    static constexpr size_t default_min_frozen_sequences = 64;
+
+    // Length of the k-mers that are sketched to estimate the distance between sequences
+    static constexpr size_t guide_kmer_length = 12;
+
+    // Number of minimizing hashes kept per sequence (bottom-s MinHash)
+    static constexpr size_t guide_sketch_size = 128;
+
+    /// Methods ///
+    explicit SpoaAligner(
+            bool adaptive = false,
+            double max_single_pass_divergence = default_max_single_pass_divergence,
+            size_t n_threads = 1,
+            size_t min_frozen_sequences = default_min_frozen_sequences);
+
+    string describe() const override;
+
+    uint64_t get_n_single_pass() const;
+    uint64_t get_n_two_pass() const;
+
+    // Estimated from the duration of the first pass, where the second one was skipped
+    double get_seconds_saved() const;
+
+    // Total size of the final SPOA graphs, before they are converted and unchopped
+    uint64_t get_n_poa_nodes() const;
+
+    // Number of bicliques whose second round was aligned to a frozen graph
+    uint64_t get_n_frozen() const;
+
+    // Distinct sequences were added to the SPOA graph in order, starting at first_spoa_id, and each sequence follows
+    // the SPOA path of its distinct representative (an index into the distinct sequences). Runs of SPOA nodes that
+    // every path traverses together are emitted as single nodes, so the result is the same as converting each base to
+    // a node and unchopping, without building the per-base graph
+    static void convert_spoa_to_bdsg(
+            Graph& spoa_graph,
+            uint32_t first_spoa_id,
+            const vector<string>& sequences,
+            const vector<size_t>& representatives,
+            Subgraph& subgraph);
+
+    // Order the distinct sequences (given as indexes into distinct_indexes) for insertion into the POA. Starts from the
+    // medoid by k-mer sketch distance (weighted by copy number), then repeatedly takes the remaining sequence that is
+    // closest to any sequence already taken, i.e. the order in which a single linkage guide tree would join them
+    static vector<size_t> get_guide_order(
+            const vector<string>& sequences,
+            const vector<size_t>& distinct_indexes,
+            const vector<uint32_t>& weights);
+
+protected:
+    void align_divergent(const vector<string>& sequences, Subgraph& subgraph) override;
+
+private:
+    bool consensus_is_sufficient(
+            const string& consensus,
+            const vector<string>& sequences,
+            const vector<size_t>& distinct_indexes) const;
+
+    // Align each distinct sequence once, weighted by the number of times it occurs, so that the consensus is the same
+    // as if every copy had been aligned
+    static void add_alignments_to_poa(
+            Graph& spoa_graph,
+            unique_ptr<AlignmentEngine>& alignment_engine,
+            const vector<string>& sequences,
+            const vector<size_t>& distinct_indexes,
+            const vector<uint32_t>& weights);
+
+    // Align every distinct sequence to the graph as it is (in parallel), and only then add the alignments, in order.
+    // Sequences can't share the nodes that are added for each other, but the result doesn't depend on n_threads
+    void add_alignments_to_frozen_poa(
+            Graph& spoa_graph,
+            const vector<string>& sequences,
+            const vector<size_t>& distinct_indexes,
+            const vector<uint32_t>& weights) const;
+};
+
+
+// Aligns each sequence to the first one with a wavefront alignment and merges it onto the first as a backbone. For
+// sequences of length n that differ by s edits this takes O(n*s) time instead of the O(n^2) of full DP, so it is
+// intended for overlaps with low divergence. Every wavefront is kept for the traceback, which takes O(s^2) memory, so
+// the number of edits is bounded and bicliques with a sequence that needs more are given to a fallback aligner
+class WavefrontAligner: public OverlapAligner{
+private:
+    /// Attributes ///
+    // Only set if no fallback aligner was given
+    unique_ptr<OverlapAligner> own_fallback_aligner;
+    OverlapAligner& fallback_aligner;
+    double max_edit_fraction;
+    int64_t max_edits;
+
+    atomic <uint64_t> n_fallbacks{0};
+
+public:
+    // Above this fraction of edits per aligned base, automatic selection falls back to SpoaAligner
+    static constexpr double default_max_divergence = 0.01;
+
+    // Sequences are aligned to the backbone with at most this fraction of edits per base of the longer one, plus
+    // min_max_edits so that short sequences don't fall back over one or two errors, and never more than
+    // default_max_edits (about 32 MiB of wavefronts)
+    static constexpr double default_max_edit_fraction = 0.05;
+    static constexpr int64_t min_max_edits = 8;
+    static constexpr int64_t default_max_edits = 2048;
+
+    /// Methods ///
+    // Falls back to its own SpoaAligner
+    WavefrontAligner();
+
+    explicit WavefrontAligner(
+            OverlapAligner& fallback_aligner,
+            double max_edit_fraction = default_max_edit_fraction,
+            int64_t max_edits = default_max_edits);
+
+    // Global unit cost (edit distance) alignment of query to ref, as =, X, I and D operations. Returns false (leaving
+    // the operations empty) if it would take more than max_edits
+    static bool align_pair(const string& ref, const string& query, int64_t max_edits, vector<Cigar>& operations);
+
+    // Unit cost edit distance between the sequences, or -1 if it is greater than max_edits
+    static int64_t edit_distance(const string& ref, const string& query, int64_t max_edits);
+
+    string describe() const override;
+
+    // Number of bicliques that were given to the fallback aligner
+    uint64_t get_n_fallbacks() const;
+
+protected:
+    void align_divergent(const vector<string>& sequences, Subgraph& subgraph) override;
+};
+
+
+// For overlaps that are too long for full DP (e.g. 50-200 kb between ultra-long read assemblies). Cuts the sequences
+// into windows between exact anchors that they all share in the same order, aligns the windows independently (and in
+// parallel) with another aligner, and threads each path through its windows with a shared node for each anchor
+class WindowedAligner: public OverlapAligner{
+private:
+    /// Attributes ///
+    OverlapAligner& window_aligner;
+    size_t n_threads;
+
+    atomic <uint64_t> n_windowed{0};
+    atomic <uint64_t> n_windows{0};
+
+public:
+    // Anchors are k-mers of this length that occur exactly once in every sequence
+    static constexpr size_t anchor_length = 21;
+
+    // Anchors are skipped until a window would be at least this long, so that windows are not dominated by their ends
+    static constexpr size_t window_length = 1000;
+
+    // Overlaps at least this long are windowed by default
+    static constexpr size_t default_min_overlap_length = 20000;
+
+    /// Methods ///
+    explicit WindowedAligner(OverlapAligner& window_aligner, size_t n_threads = 1);
+
+    string describe() const override;
+
+    uint64_t get_n_windowed() const;
+    uint64_t get_n_windows() const;
+
+    // Start of each chained anchor in each sequence, as anchors[a][s]. Anchors are in increasing order and don't
+    // overlap in any of the sequences
+    static vector <vector <size_t> > find_anchors(const vector<string>& sequences);
+
+protected:
+    void align_divergent(const vector<string>& sequences, Subgraph& subgraph) override;
+};
+
+
+// Construct an aligner by name, either "spoa" or "wfa"
+unique_ptr<OverlapAligner> make_overlap_aligner(const string& name);
+
+
+}
+
+#endif //BLUNTIFIER_OVERLAPALIGNER_HPP
@@ -2,14 +2,19 @@
 #define BLUNTIFIER_OVERLAPPINGOVERLAP_HPP
 
 #include "handlegraph/handle_graph.hpp"
+#include "handlegraph/path_handle_graph.hpp"
+#include "Parentage.hpp"
 
 #include <string>
 #include <vector>
 #include <deque>
 #include <array>
 #include <map>
+#include <tuple>
+#include <utility>
 
 using handlegraph::HandleGraph;
+using handlegraph::PathHandleGraph;
 using handlegraph::path_handle_t;
 using handlegraph::handle_t;
 using handlegraph::nid_t;
@@ -19,6 +24,9 @@ using std::vector;
 using std::deque;
 using std::array;
 using std::multimap;
+using std::map;
+using std::pair;
+using std::tuple;
 
 
 namespace bluntifier{
@@ -61,6 +69,69 @@ public:
     void print(HandleGraph& graph);
 
 };
+
+
+// The OO nodes in ascending order of parent node ID, which is the order that the Duplicator finds them in, with a dense
+// index from node ID for lookups
+class OverlappingOverlapNodes{
+private:
+    /// Attributes ///
+    vector <OverlappingNodeInfo> nodes;
+
+    // Position of each node in the vector above, or -1
+    vector <int64_t> node_indexes;
+
+public:
+    /// Methods ///
+
+    // The node must have a greater ID than the nodes that were already added. The reference is only valid until the
+    // next one is added
+    OverlappingNodeInfo& emplace(nid_t parent_node);
+
+    // Returns nullptr if this is not an OO node
+    const OverlappingNodeInfo* find(nid_t parent_node) const;
+
+    size_t size() const;
+    bool empty() const;
+
+    vector<OverlappingNodeInfo>::iterator begin();
+    vector<OverlappingNodeInfo>::iterator end();
+    vector<OverlappingNodeInfo>::const_iterator begin() const;
+    vector<OverlappingNodeInfo>::const_iterator end() const;
+};
+
+
+// The role of each node in the overlapping overlap (OO) nodes, indexed by node ID once the termini have been
+// duplicated, so that it can be looked up for every terminus that is spliced
+class OverlappingOverlapIndex{
+private:
+    /// Attributes ///
+    // Nodes that are left over from an OO node's parent and lie on its parent path
+    vector <bool> is_parent_material;
+
+    // Terminus children of an OO node that overlap other termini, which are excluded from normal splicing
+    vector <bool> is_overlapping_child;
+
+public:
+    /// Methods ///
+    OverlappingOverlapIndex()=default;
+
+    OverlappingOverlapIndex(
+            const PathHandleGraph& graph,
+            const Parentage& parentage,
+            const OverlappingOverlapNodes& overlapping_overlap_nodes);
+
+    // Returns {is_oo_parent, is_oo_child}
+    tuple <bool, bool> get_roles(nid_t node_id) const;
+
+    // The same, found by searching the parent path and the overlapping children of the node's parent
+    static tuple <bool, bool> find_roles(
+            const PathHandleGraph& graph,
+            const Parentage& parentage,
+            const OverlappingOverlapNodes& overlapping_overlap_nodes,
+            nid_t node_id);
+};
+
 }
 
 #endif //BLUNTIFIER_OVERLAPPINGOVERLAP_HPP
@@ -3,11 +3,14 @@
 #define BLUNTIFIER_OVERLAPPINGOVERLAPSPLICER_HPP
 
 #include "handlegraph/mutable_path_deletable_handle_graph.hpp"
+#include "handlegraph/path_handle_graph.hpp"
 #include "handlegraph/handle_graph.hpp"
 #include "OverlappingOverlap.hpp"
 #include "Subgraph.hpp"
 #include "utility.hpp"
 #include <utility>
+#include <thread>
+#include <atomic>
 #include <set>
 
 using std::runtime_error;
@@ -17,8 +20,11 @@ using std::vector;
 using std::tuple;
 using std::pair;
 using std::set;
+using std::thread;
+using std::atomic;
 
 using handlegraph::MutablePathDeletableHandleGraph;
+using handlegraph::PathHandleGraph;
 using handlegraph::HandleGraph;
 using handlegraph::handle_t;
 using handlegraph::nid_t;
@@ -45,16 +51,41 @@ public:
 };
 
 
+// Cumulative lengths of the steps of a path, so that the step containing a base can be found with a binary search
+// instead of by walking the path. Any division of a node on the path must be passed to update_division
+class PathOffsetIndex{
+public:
+    /// Attributes ///
+    vector <handle_t> handles;
+
+    // The number of bases before each step, followed by the length of the path
+    vector <size_t> offsets;
+
+    /// Methods ///
+    PathOffsetIndex(const PathHandleGraph& graph, const path_handle_t& path);
+
+    // Returns the same {handle, intra-handle index, remainder, fail} as walking the path forward, or backward from its
+    // end with the handles flipped, until the cumulative length reaches target_base_index
+    tuple<handle_t, size_t, size_t, bool> seek(size_t target_base_index) const;
+    tuple<handle_t, size_t, size_t, bool> seek_reverse(const HandleGraph& graph, size_t target_base_index) const;
+
+    // Replace the steps on the divided handle's node with the parts that divide_handle returned for it
+    void update_division(const HandleGraph& graph, const handle_t& divided_handle, const vector<handle_t>& parts);
+};
+
+
 class OverlappingOverlapSplicer {
 public:
-    map <nid_t, OverlappingNodeInfo>& overlapping_overlap_nodes;
-    map <nid_t, set<nid_t> >& parent_to_children;
-    const vector<Subgraph>& subgraphs;
+    OverlappingOverlapNodes& overlapping_overlap_nodes;
+    const Parentage& parentage;
+    const vector<SplicedPaths>& spliced_paths;
+    size_t n_threads;
 
     OverlappingOverlapSplicer(
-            map<nid_t, OverlappingNodeInfo>& overlapping_overlap_nodes,
-            map <nid_t, set<nid_t> >& parent_to_children,
-            const vector<Subgraph>& subgraphs);
+            OverlappingOverlapNodes& overlapping_overlap_nodes,
+            const Parentage& parentage,
+            const vector<SplicedPaths>& spliced_paths,
+            size_t n_threads = 1);
 
     void splice_overlapping_overlaps(
             MutablePathDeletableHandleGraph& gfa_graph);
@@ -64,7 +95,6 @@ private:
             const HandleGraph& gfa_graph,
             size_t biclique_index,
             handle_t handle,
-            PathInfo& path_info,
             string& path_name);
 
     void find_splice_pairs(
@@ -72,18 +102,30 @@ private:
             OverlappingNodeInfo& overlap_info,
             vector <OverlappingSplicePair>& oo_splice_pairs);
 
-    // Iterate along a path until the cumulative number of bases iterated would equal "target_base_index" and then
-    // return the handle and intra-handle index
+    // Divide the handles at the splice pairs that were found for one OO node and create the edges between them
+    void splice_pairs_of_node(
+            MutablePathDeletableHandleGraph& gfa_graph,
+            vector<OverlappingSplicePair>& oo_splice_pairs);
+
+    // Find the base of a path at "target_base_index" and return the handle and intra-handle index. The offsets of each
+    // path are indexed the first time it is seen
     tuple<handle_t, size_t, size_t, bool> seek_to_path_base(
             MutablePathDeletableHandleGraph& gfa_graph,
+            map<string, PathOffsetIndex>& path_indexes,
             string& path_name,
             size_t target_base_index);
 
     tuple<handle_t, size_t, size_t, bool> seek_to_reverse_path_base(
             MutablePathDeletableHandleGraph& gfa_graph,
+            map<string, PathOffsetIndex>& path_indexes,
             string& path_name,
             size_t target_base_index);
 
+    PathOffsetIndex& get_path_index(
+            MutablePathDeletableHandleGraph& gfa_graph,
+            map<string, PathOffsetIndex>& path_indexes,
+            string& path_name);
+
 };
 
 }
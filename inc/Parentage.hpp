@@ -0,0 +1,62 @@
+#ifndef BLUNTIFIER_PARENTAGE_HPP
+#define BLUNTIFIER_PARENTAGE_HPP
+
+#include "handlegraph/handle_graph.hpp"
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <utility>
+
+using handlegraph::nid_t;
+using std::runtime_error;
+using std::to_string;
+using std::function;
+using std::vector;
+using std::pair;
+
+
+namespace bluntifier{
+
+
+// Which original GFA node each duplicated terminus (child) was made from, and the children of each parent. Node IDs
+// are dense integers (assigned by the IncrementalIdMap and then by create_handle), so both directions are stored in
+// arrays indexed by ID
+class Parentage{
+private:
+    /// Attributes ///
+
+    // The parent of each child, or 0 (which is never a node ID) if the node is not a child
+    vector <nid_t> parents;
+
+    // Whether each child is a suffix/prefix of its parent, rather than the original node material
+    vector <bool> is_terminus;
+
+    // The children of each parent are child_ids[child_starts[parent]] up to child_ids[child_starts[parent + 1]], in
+    // ascending order
+    vector <size_t> child_starts;
+    vector <nid_t> child_ids;
+
+public:
+    /// Methods ///
+
+    void add_child(nid_t child_node, nid_t parent_node, bool is_terminus);
+
+    // Build the lists of children. Children that are added afterwards are only found by get_parent until this is
+    // called again
+    void index_children();
+
+    bool is_child(nid_t node_id) const;
+
+    // Returns {parent_node, is_terminus}, and throws if the node is not a child
+    pair<nid_t, bool> get_parent(nid_t child_node) const;
+
+    size_t get_child_count(nid_t parent_node) const;
+
+    void for_each_child(nid_t parent_node, const function<void(nid_t child_node)>& f) const;
+};
+
+
+}
+
+#endif //BLUNTIFIER_PARENTAGE_HPP
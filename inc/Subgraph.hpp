@@ -2,18 +2,26 @@
 #define BLUNTIFIER_SUBGRAPH_HPP
 
 #include "handlegraph/handle_graph.hpp"
+#include "handlegraph/mutable_path_mutable_handle_graph.hpp"
 #include "bdsg/hash_graph.hpp"
 #include "utility.hpp"
 
+#include <cstdint>
 #include <array>
 #include <map>
+#include <functional>
 
 using bdsg::HashGraph;
+using handlegraph::MutablePathMutableHandleGraph;
+using handlegraph::HandleGraph;
 using handlegraph::path_handle_t;
 using handlegraph::handle_t;
+using handlegraph::nid_t;
 
 using std::array;
 using std::map;
+using std::pair;
+using std::function;
 
 
 namespace bluntifier {
@@ -21,6 +29,8 @@ namespace bluntifier {
 class PathInfo{
 public:
     path_handle_t path_handle;
+
+    // Index of this path's sequence in the input to the OverlapAligner
     uint32_t spoa_id;
     bool biclique_side;
 
@@ -37,7 +47,92 @@ public:
     // In terms of the biclique, record the side of each overlap and the name needed to fetch that path after copying
     array <map <handle_t, PathInfo>, 2> paths_per_handle;
 
+    // Paths of sequences that are aligned on their own rather than for the handles of a biclique (e.g. the windows of
+    // a long overlap, or the templates of the AlignmentCache), indexed by spoa_id
+    vector <PathInfo> sequence_paths;
+
     Subgraph()=default;
+
+    // Add a path to sequence_paths for each of the sequences to be aligned, named by its index
+    void create_sequence_paths(size_t n_sequences);
+
+    // Visit the paths for the handles of both sides, and then the sequence paths
+    void for_each_path(const function<void(const PathInfo& path_info)>& f) const;
+
+    // The path of each of the sequences that were aligned, indexed by spoa_id
+    vector <path_handle_t> get_paths_by_sequence(size_t n_sequences) const;
+};
+
+
+// A finished Subgraph flattened into contiguous arrays. One of these is kept for every biclique until splicing, so it
+// only holds what is needed to insert it into the main graph and to find its paths again
+class CompactSubgraph{
+public:
+    /// Attributes ///
+    // Node IDs are kept so that splicing assigns the same IDs as copying the original HashGraph would
+    vector <nid_t> node_ids;
+
+    // Node n spells sequence[sequence_starts[n], sequence_starts[n+1])
+    string sequence;
+    vector <uint64_t> sequence_starts;
+
+    // Handles are stored as 2*node_index + is_reverse
+    vector <pair <uint64_t, uint64_t> > edges;
+
+    // Path p is steps[step_starts[p], step_starts[p+1])
+    vector <string> path_names;
+    vector <uint64_t> step_starts;
+    vector <uint64_t> steps;
+
+    // For each side of the biclique, the handles that participated in it and the index of their path, sorted by handle
+    array <vector <pair <handle_t, uint32_t> >, 2> paths_per_handle;
+
+    /// Methods ///
+    CompactSubgraph()=default;
+
+    explicit CompactSubgraph(const Subgraph& subgraph);
+
+    // Index of the path for this handle on this side of the biclique, or -1 if it didn't participate
+    int64_t find_path(bool side, const handle_t& handle) const;
+
+    size_t get_node_count() const;
+
+    // Largest node ID before offsetting, or 0 if there are no nodes
+    nid_t get_max_node_id() const;
+
+    // Add the nodes (with their IDs increased by id_offset), edges and paths to the graph, and return the path handles
+    // that were created for each path, in order
+    vector <path_handle_t> insert_into(MutablePathMutableHandleGraph& graph, nid_t id_offset) const;
+
+    // The two halves of insert_into, so that many subgraphs can have their nodes created before any edges. Returns
+    // the handle of each node, as needed by the other methods
+    vector <handle_t> insert_nodes(MutablePathMutableHandleGraph& graph, nid_t id_offset) const;
+
+    vector <path_handle_t> insert_edges_and_paths(
+            MutablePathMutableHandleGraph& graph,
+            const vector<handle_t>& handles) const;
+
+    // The first and last handles of a path, once the nodes have been inserted. Paths are never empty
+    handle_t get_path_front(size_t path_index, const HandleGraph& graph, const vector<handle_t>& handles) const;
+    handle_t get_path_back(size_t path_index, const HandleGraph& graph, const vector<handle_t>& handles) const;
+};
+
+
+// What is left of a biclique's subgraph once it has been spliced into the main graph: the name of the path that each
+// participating handle was threaded through, which the OverlappingOverlapSplicer uses to find it again
+class SplicedPaths{
+public:
+    /// Attributes ///
+    // For each side of the biclique, sorted by handle
+    array <vector <pair <handle_t, string> >, 2> path_names_per_handle;
+
+    /// Methods ///
+    SplicedPaths()=default;
+
+    explicit SplicedPaths(const CompactSubgraph& subgraph);
+
+    // Name of the path for this handle on this side of the biclique, or nullptr if it didn't participate
+    const string* find_path_name(bool side, const handle_t& handle) const;
 };
 
 
@@ -2,11 +2,14 @@
 #define BLUNTIFIER_HANDLE_TO_GFA_HPP
 
 #include "handlegraph/handle_graph.hpp"
+#include <functional>
 #include <fstream>
 
 using handlegraph::HandleGraph;
 using handlegraph::handle_t;
 using handlegraph::edge_t;
+using handlegraph::nid_t;
+using std::function;
 using std::runtime_error;
 using std::ostream;
 using std::string;
@@ -28,6 +31,11 @@ void write_edge_to_gfa(const HandleGraph& graph, const edge_t& edge, ostream& ou
 void handle_graph_to_gfa(const HandleGraph& graph, ostream& output_gfa);
 
 
+/// The same, but leaving out the nodes that are excluded and all of their edges, so that many nodes can be dropped
+/// from the output without deleting them from the graph one at a time
+void handle_graph_to_gfa(const HandleGraph& graph, ostream& output_gfa, const function<bool(nid_t)>& is_excluded);
+
+
 // TODO write this method to use the overlaps and id map to write the linkages/sequences in the canonical direction
 // using the canonical names as well, wherever possible
 void handle_graph_to_canonical_gfa(const HandleGraph& graph, const string& output_path);
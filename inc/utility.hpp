@@ -6,10 +6,14 @@
 #include <string>
 #include <vector>
 #include <tuple>
+#include <thread>
+#include <functional>
 
 using std::string;
 using std::vector;
 using std::runtime_error;
+using std::thread;
+using std::function;
 
 
 namespace bluntifier {
@@ -30,6 +34,13 @@ string parent_path(string s, uint64_t n);
 
 string join_paths(string a, string b);
 
+// Run work on n_threads threads, including this one, and wait for them. A thread that is already running a parallel
+// loop (this one or start_parallel_workers) runs nested loops alone, so that nested thread counts don't multiply
+void run_in_parallel(size_t n_threads, const function<void()>& work);
+
+// Start n_threads threads running work in the background, which the caller must join. Loops nested in them run serially
+void start_parallel_workers(size_t n_threads, const function<void()>& work, vector<thread>& workers);
+
 
 template<typename Map> void
 less_than(Map& m, typename Map::key_type k, vector<typename Map::iterator>& result) {
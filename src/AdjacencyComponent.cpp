@@ -22,6 +22,21 @@ using std::linear_congruential_engine;
 using std::uniform_int_distribution;
 using std::cerr;
 using std::endl;
+using std::unordered_map;
+using std::min;
+using std::max;
+using std::runtime_error;
+using std::to_string;
+using std::thread;
+using std::atomic;
+
+// a fast, well-mixed 64 bit hash (from Steele, Lea, & Flood 2014)
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
 
 bool AdjacencyComponent::for_each_adjacent_side(const handle_t& side,
                                            const function<bool(handle_t)>& lambda) const {
@@ -104,6 +119,70 @@ void for_each_adjacency_component(const HandleGraph& graph,
     });
 }
 
+AdjacencyEdgeArray::AdjacencyEdgeArray(const HandleGraph& graph, const vector<handle_t>& sides)
+    : sides(sides)
+{
+    unordered_map<handle_t, size_t> side_index;
+    side_index.reserve(sides.size());
+    for (size_t i = 0; i < sides.size(); ++i) {
+        side_index[sides[i]] = i;
+    }
+    
+    // assign edge IDs the first time we see an edge from the lower-indexed side,
+    // so that both directions of the edge share the same ID
+    unordered_map<pair<size_t, size_t>, size_t> edge_id_of;
+    offsets.reserve(sides.size() + 1);
+    offsets.push_back(0);
+    for (size_t i = 0; i < sides.size(); ++i) {
+        graph.follow_edges(sides[i], false, [&](const handle_t& neighbor) {
+            size_t j = side_index.at(graph.flip(neighbor));
+            auto key = make_pair(min(i, j), max(i, j));
+            auto it = edge_id_of.find(key);
+            if (it == edge_id_of.end()) {
+                it = edge_id_of.emplace(key, edge_count++).first;
+            }
+            adjacent_sides.push_back(j);
+            edge_ids.push_back(it->second);
+        });
+        offsets.push_back(adjacent_sides.size());
+    }
+    
+    removed.resize((edge_count + 63) / 64, 0);
+}
+
+size_t AdjacencyEdgeArray::num_sides() const {
+    return sides.size();
+}
+
+size_t AdjacencyEdgeArray::num_edges() const {
+    return edge_count;
+}
+
+handle_t AdjacencyEdgeArray::get_side(size_t i) const {
+    return sides[i];
+}
+
+bipartition AdjacencyComponent::to_bipartition(const vector<size_t>& active,
+                                               const vector<bool>& on_left) const {
+    bipartition return_val;
+    for (size_t i : active) {
+        if (on_left[i]) {
+            return_val.first.insert(component[i]);
+        }
+        else {
+            return_val.second.insert(component[i]);
+        }
+    }
+    return return_val;
+}
+
+void AdjacencyComponent::from_bipartition(const bipartition& partition, vector<bool>& on_left) const {
+    on_left.resize(component.size());
+    for (size_t i = 0; i < component.size(); ++i) {
+        on_left[i] = partition.first.count(component[i]);
+    }
+}
+
 bool AdjacencyComponent::is_bipartite() const {
     auto partition = bipartite_partition();
     return partition.first.size() + partition.second.size() == component.size();
@@ -111,66 +190,104 @@ bool AdjacencyComponent::is_bipartite() const {
 
 bipartition AdjacencyComponent::bipartite_partition() const {
     
+    AdjacencyEdgeArray edges(*graph, component);
+    vector<size_t> active(component.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        active[i] = i;
+    }
+    vector<bool> on_left(component.size(), false);
+    
     bipartition return_val;
+    if (bipartite_partition(edges, active, on_left)) {
+        return_val = to_bipartition(active, on_left);
+    }
+    return return_val;
+}
+
+bool AdjacencyComponent::bipartite_partition(const AdjacencyEdgeArray& edges,
+                                             const vector<size_t>& active,
+                                             vector<bool>& on_left) const {
     
-    if (!component.empty()) {
-        
-        handle_t start_side = *component.begin();
-        
-        vector<pair<handle_t, bool>> stack(1, make_pair(start_side, false));
-        return_val.first.insert(start_side);
+    if (active.empty()) {
+        return true;
+    }
+    
+    vector<bool> assigned(edges.num_sides(), false);
+    
+    size_t start_side = active.front();
+    
+    vector<size_t> stack(1, start_side);
+    assigned[start_side] = true;
+    on_left[start_side] = true;
+    
+    while (!stack.empty()) {
+        size_t side_here = stack.back();
+        stack.pop_back();
         
-        while (!stack.empty()) {
-            bool going_left;
-            handle_t side_here;
-            tie(side_here, going_left) = stack.back();
-            stack.pop_back();
-            
 #ifdef debug_is_bipartite
-            cerr << "traversal at " << graph->get_id(side_here) << " " << graph->get_is_reverse(side_here) << ", going left? " << going_left << endl;
+        cerr << "traversal at " << graph->get_id(component[side_here]) << " " << graph->get_is_reverse(component[side_here]) << ", going left? " << !on_left[side_here] << endl;
 #endif
-            
-            auto& partition_across = going_left ? return_val.first : return_val.second;
-            auto& partition_here = going_left ? return_val.second : return_val.first;
-            
-            bool still_bipartite = for_each_adjacent_side(side_here,
-                                                          [&](handle_t adjacent_side) {
+        
+        bool still_bipartite = true;
+        edges.for_each_edge(side_here, [&](size_t adjacent_side, size_t edge_id) {
+            if (!still_bipartite) {
+                return;
+            }
 #ifdef debug_is_bipartite
-                cerr << "\tcheck adjacent " <<  graph->get_id(adjacent_side) << " " << graph->get_is_reverse(adjacent_side) << endl;
+            cerr << "\tcheck adjacent " <<  graph->get_id(component[adjacent_side]) << " " << graph->get_is_reverse(component[adjacent_side]) << endl;
 #endif
-                if (partition_here.count(adjacent_side)) {
-                    // this side was seen with both even and odd parities, the
-                    // adjacency component is not bipartite
+            if (!assigned[adjacent_side]) {
+                // add this side to the partition and prepare a search from it
+                // with the opposite parity
+                assigned[adjacent_side] = true;
+                on_left[adjacent_side] = !on_left[side_here];
+                stack.push_back(adjacent_side);
+            }
+            else if (on_left[adjacent_side] == on_left[side_here]) {
+                // this side was seen with both even and odd parities, the
+                // adjacency component is not bipartite
 #ifdef debug_is_bipartite
-                    cerr << "\t\twrong parity, component is not bipartite" << endl;
+                cerr << "\t\twrong parity, component is not bipartite" << endl;
 #endif
-                    return false;
-                }
-                else if (!partition_across.count(adjacent_side)) {
-                    // add this side to the partition and prepare a search from it
-                    // with the opposite parity
-                    partition_across.insert(adjacent_side);
-                    stack.emplace_back(adjacent_side, !going_left);
-                }
-                
-                return true;
-            });
-            
-            if (!still_bipartite) {
-                // prepare to return a sentinel and stop searching
-                return_val.first.clear();
-                return_val.second.clear();
-                break;
+                still_bipartite = false;
             }
-        }
+        });
         
+        if (!still_bipartite) {
+            return false;
+        }
     }
     
-    return return_val;
+    // we also require that we reached all of the sides, which is not guaranteed
+    // if edges have been removed
+    for (size_t i : active) {
+        if (!assigned[i]) {
+            return false;
+        }
+    }
+    
+    return true;
 }
 
 bipartition AdjacencyComponent::maximum_bipartite_partition_apx_1_2(uint64_t seed) const {
     
+    AdjacencyEdgeArray edges(*graph, component);
+    vector<size_t> active(component.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        active[i] = i;
+    }
+    vector<bool> on_left(component.size(), false);
+    
+    maximum_bipartite_partition_apx_1_2(edges, active, on_left, seed);
+    
+    return to_bipartition(active, on_left);
+}
+
+void AdjacencyComponent::maximum_bipartite_partition_apx_1_2(const AdjacencyEdgeArray& edges,
+                                                             const vector<size_t>& active,
+                                                             vector<bool>& on_left,
+                                                             uint64_t seed) const {
+    
     // m = largest prime less than 2^64-1
     // a, b were generated by uniform random variables in [0, m)
     linear_congruential_engine<uint64_t,
@@ -179,339 +296,600 @@ bipartition AdjacencyComponent::maximum_bipartite_partition_apx_1_2(uint64_t see
                                18446744073709551557ull> gen(seed);
     uniform_int_distribution<int> coin_flip(0, 1);
     
-    bipartition return_val;
+    size_t left_size = 0;
+    for (size_t i : active) {
+        on_left[i] = coin_flip(gen);
+        left_size += on_left[i];
+    }
+    
+    // ensure that both sides of the partition are non-empty
+    if (!active.empty() && (left_size == 0 || left_size == active.size())) {
+        on_left[active.front()] = !on_left[active.front()];
+    }
+}
+
+void AdjacencyComponent::refine_apx_partition(bipartition& partition, size_t max_opt_steps) const {
+    
+    AdjacencyEdgeArray edges(*graph, component);
+    vector<size_t> active(component.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        active[i] = i;
+    }
+    vector<bool> on_left;
+    from_bipartition(partition, on_left);
+    
+    refine_apx_partition(edges, active, on_left, max_opt_steps);
+    
+    partition = to_bipartition(active, on_left);
+}
+
+/*
+ * Fiduccia-Mattheyses style bookkeeping for local search on a bipartition. Every side
+ * has a gain (the change in the number of edges across the partition if it switched
+ * parts), and the sides that are eligible to move are kept in buckets by gain, so
+ * that each move costs time proportional to the degree of the side moved. Edge swaps
+ * are only looked for around the sides whose gains have changed since they were last
+ * checked.
+ */
+class GainBucketRefiner {
+public:
+    GainBucketRefiner(const AdjacencyEdgeArray& edges, const vector<size_t>& active,
+                      const vector<bool>& on_left);
+    
+    // make single side moves and edge swaps until the partition is locally optimal
+    // in the sense of Bylka, Idzik, & Tuza (1999) (or we hit max_opt_steps)
+    void refine(size_t max_opt_steps);
+    
+    bool is_on_left(size_t v) const;
     
-    for (const handle_t& side : component) {
-        if (coin_flip(gen)) {
-            return_val.first.insert(side);
+private:
+    
+    static constexpr size_t NONE = numeric_limits<size_t>::max();
+    
+    // a side is eligible if it is in Bylka, Idzik, & Tuza's S_1 or S_3, third component
+    bool is_eligible(size_t v) const;
+    bool can_move(size_t v) const;
+    void insert(size_t v);
+    void erase(size_t v);
+    void update(size_t v);
+    void move_side(size_t v);
+    // returns NONE if there are no eligible sides that can be moved
+    size_t pop_best();
+    // queue a side to have its edges across the partition checked for a swap
+    void mark_for_swap(size_t v);
+    // swap the ends of an edge across the partition that has v as one end, if that
+    // would improve the partition
+    bool swap_edge(size_t v);
+    
+    // CSR adjacency among the sides, in local indexes
+    vector<size_t> offsets;
+    vector<size_t> neighbors;
+    
+    vector<bool> left;
+    vector<int64_t> gain;
+    size_t left_size = 0;
+    size_t right_size = 0;
+    
+    // doubly linked lists of eligible sides, indexed by gain + max_degree
+    int64_t max_degree = 0;
+    vector<size_t> bucket_head;
+    vector<size_t> next;
+    vector<size_t> prev;
+    vector<bool> in_bucket;
+    size_t max_bucket = 0;
+    // eligible sides that could not move without emptying a part, by part (true for
+    // left), so that only the part that a side moves into needs to be revisited
+    vector<size_t> blocked[2];
+    vector<bool> is_blocked;
+    
+    // the sides whose gain or part changed since their edges were last checked for a
+    // swap, and initially all of them. an edge can only become a swap candidate when
+    // one of its ends is in here
+    vector<size_t> swap_worklist;
+    vector<bool> in_swap_worklist;
+};
+
+GainBucketRefiner::GainBucketRefiner(const AdjacencyEdgeArray& edges, const vector<size_t>& active,
+                                     const vector<bool>& on_left) {
+    
+    vector<size_t> local_index(edges.num_sides(), NONE);
+    for (size_t k = 0; k < active.size(); ++k) {
+        local_index[active[k]] = k;
+    }
+    
+    offsets.reserve(active.size() + 1);
+    offsets.push_back(0);
+    left.resize(active.size());
+    for (size_t k = 0; k < active.size(); ++k) {
+        edges.for_each_edge(active[k], [&](size_t adj_side, size_t edge_id) {
+            if (adj_side != active[k]) {
+                // reversing self-loops are always within the partition, so they can't
+                // affect the gain
+                neighbors.push_back(local_index[adj_side]);
+            }
+        });
+        offsets.push_back(neighbors.size());
+        max_degree = max<int64_t>(max_degree, offsets[k + 1] - offsets[k]);
+        left[k] = on_left[active[k]];
+        if (left[k]) {
+            ++left_size;
         }
         else {
-            return_val.second.insert(side);
+            ++right_size;
         }
     }
     
-    // ensure that both sides of the partition are non-empty8
-    if (return_val.first.empty() && !return_val.second.empty()) {
-        return_val.first.insert(component.front());
-        return_val.second.erase(component.front());
+    gain.resize(active.size(), 0);
+    for (size_t v = 0; v < active.size(); ++v) {
+        for (size_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+            gain[v] += (left[v] == left[neighbors[k]]) ? 1 : -1;
+        }
     }
-    else if (return_val.second.empty() && !return_val.first.empty()) {
-        return_val.second.insert(component.front());
-        return_val.first.erase(component.front());
+    
+    bucket_head.resize(2 * max_degree + 1, NONE);
+    next.resize(active.size(), NONE);
+    prev.resize(active.size(), NONE);
+    in_bucket.resize(active.size(), false);
+    max_bucket = max_degree;
+    for (size_t v = 0; v < active.size(); ++v) {
+        if (is_eligible(v)) {
+            insert(v);
+        }
     }
+    is_blocked.resize(active.size(), false);
     
-    return return_val;
+    // queued in reverse so that the sides are first checked in order
+    in_swap_worklist.resize(active.size(), false);
+    swap_worklist.reserve(active.size());
+    for (size_t v = active.size(); v > 0; --v) {
+        mark_for_swap(v - 1);
+    }
 }
 
-void AdjacencyComponent::refine_apx_partition(bipartition& partition, size_t max_opt_steps) const {
-    
-#ifdef debug_refinement
-    cerr << "doing local search to refine an approximate partition:" << endl;
-    cerr << "left" << endl;
-    for (auto h : partition.first) {
-        cerr << "\t" << graph->get_id(h) << " " << graph->get_is_reverse(h) << endl;
+bool GainBucketRefiner::is_on_left(size_t v) const {
+    return left[v];
+}
+
+bool GainBucketRefiner::is_eligible(size_t v) const {
+    return gain[v] > 0 || (gain[v] == 0 && left[v]);
+}
+
+bool GainBucketRefiner::can_move(size_t v) const {
+    return left[v] ? left_size > 1 : right_size > 1;
+}
+
+void GainBucketRefiner::insert(size_t v) {
+    size_t b = gain[v] + max_degree;
+    next[v] = bucket_head[b];
+    prev[v] = NONE;
+    if (bucket_head[b] != NONE) {
+        prev[bucket_head[b]] = v;
     }
-    cerr << "right" << endl;
-    for (auto h : partition.second) {
-        cerr << "\t" << graph->get_id(h) << " " << graph->get_is_reverse(h) << endl;
+    bucket_head[b] = v;
+    in_bucket[v] = true;
+    max_bucket = max(max_bucket, b);
+}
+
+void GainBucketRefiner::erase(size_t v) {
+    if (prev[v] != NONE) {
+        next[prev[v]] = next[v];
     }
-#endif
-    
-    bool no_optimizations_left = false;
+    else {
+        bucket_head[gain[v] + max_degree] = next[v];
+    }
+    if (next[v] != NONE) {
+        prev[next[v]] = prev[v];
+    }
+    in_bucket[v] = false;
+}
+
+void GainBucketRefiner::update(size_t v) {
+    if (in_bucket[v]) {
+        erase(v);
+    }
+    if (is_eligible(v)) {
+        insert(v);
+    }
+}
+
+void GainBucketRefiner::move_side(size_t v) {
+    if (in_bucket[v]) {
+        erase(v);
+    }
+    left[v] = !left[v];
+    if (left[v]) {
+        ++left_size;
+        --right_size;
+    }
+    else {
+        --left_size;
+        ++right_size;
+    }
+    // the side's edges within are now across, and vice versa
+    gain[v] = -gain[v];
+    mark_for_swap(v);
+    for (size_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+        size_t u = neighbors[k];
+        if (in_bucket[u]) {
+            erase(u);
+        }
+        gain[u] += (left[u] == left[v]) ? 2 : -2;
+        if (is_eligible(u)) {
+            insert(u);
+        }
+        mark_for_swap(u);
+    }
+    if (is_eligible(v)) {
+        insert(v);
+    }
+    // the part that v moved into has grown, so its sides can all move now. sides that
+    // have left it since they were blocked are just updated
+    auto& unblocked = blocked[left[v]];
+    for (size_t u : unblocked) {
+        is_blocked[u] = false;
+        update(u);
+    }
+    unblocked.clear();
+}
+
+void GainBucketRefiner::mark_for_swap(size_t v) {
+    if (!in_swap_worklist[v]) {
+        in_swap_worklist[v] = true;
+        swap_worklist.push_back(v);
+    }
+}
+
+bool GainBucketRefiner::swap_edge(size_t v) {
+    for (size_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+        size_t u = neighbors[k];
+        if (left[u] != left[v] && gain[v] + gain[u] >= -1) {
+            move_side(v);
+            move_side(u);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t GainBucketRefiner::pop_best() {
+    // eligible sides all have non-negative gain
+    while (max_bucket >= size_t(max_degree)) {
+        size_t v = bucket_head[max_bucket];
+        if (v == NONE) {
+            if (max_bucket == 0) {
+                break;
+            }
+            --max_bucket;
+            continue;
+        }
+        erase(v);
+        if (can_move(v)) {
+            return v;
+        }
+        // we can't empty out one side of the partition
+        if (!is_blocked[v]) {
+            is_blocked[v] = true;
+            blocked[left[v]].push_back(v);
+        }
+    }
+    return NONE;
+}
+
+void GainBucketRefiner::refine(size_t max_opt_steps) {
     size_t opt_steps = 0;
+    bool no_optimizations_left = false;
     while (!no_optimizations_left && opt_steps < max_opt_steps) {
-        // keep looping through the sides until we make an entire loop without
-        // finding a greedy improvement (or until hitting max iters)
-        bool new_loop = true;
-        for (size_t i = 0, end = 0; (i != end || new_loop) && opt_steps < max_opt_steps;
-             i = (i + 1) % component.size()) {
-            
-            new_loop = false;
-            
-            // we will check if we can improve the partition by switching
-            // this side
-            handle_t side = component[i];
-            
-            // count the edges across the partition and within it
-            bool on_left = partition.first.count(side);
-            if (on_left ? partition.first.size() <= 1 : partition.second.size() <= 1) {
-                // we
-                continue;
-            }
-            int edges_across = 0, edges_within = 0;
-            for_each_adjacent_side(side, [&](handle_t adj_side) {
-                bool nbr_on_left = partition.first.count(adj_side);
-                if (on_left == nbr_on_left) {
-                    ++edges_within;
-                }
-                else {
-                    ++edges_across;
-                }
-                return true;
-            });
-            // move if the node is in Bylka, Idzik, & Tuza's S_1
-            // or S_3, third component
-            if (edges_within > edges_across || (edges_within == edges_across && on_left)) {
-                // move it to the other side of the partition
-                new_loop = true;
-                end = i;
-                ++opt_steps;
-                if (on_left) {
-                    partition.second.insert(side);
-                    partition.first.erase(side);
-                }
-                else {
-                    partition.first.insert(side);
-                    partition.second.erase(side);
-                }
-#ifdef debug_refinement
-                cerr << "found a local move by swapping node " << graph->get_id(side) << " " << graph->get_is_reverse(side) << ", partition is now:" << endl;
-                cerr << "left" << endl;
-                for (auto h : partition.first) {
-                    cerr << "\t" << graph->get_id(h) << " " << graph->get_is_reverse(h) << endl;
-                }
-                cerr << "right" << endl;
-                for (auto h : partition.second) {
-                    cerr << "\t" << graph->get_id(h) << " " << graph->get_is_reverse(h) << endl;
-                }
-#endif
-            }
+        
+        // greedily move the best eligible side until there are none left
+        for (size_t v = pop_best(); v != NONE && opt_steps < max_opt_steps; v = pop_best()) {
+            move_side(v);
+            ++opt_steps;
         }
         
-        // keep track of whether we find any optimization with our
-        // sweep over the edges
+        // look for edges across the partition where swapping both ends would improve
+        // the partition (Bylka, Idzik, & Tuza's S_3, second component). the other
+        // edges haven't changed since they were last checked
         no_optimizations_left = true;
-        for (size_t i = 0; i < component.size() && opt_steps < max_opt_steps; ++i) {
-            handle_t side = component[i];
-            if (partition.first.count(side)) {
-                // look at swapping along edges of this side
-                
-                // count the edges within and across for this side
-                int edges_across = 0, edges_within = 0;
-                for_each_adjacent_side(side, [&](handle_t adj_side) {
-                    if (partition.second.count(adj_side)) {
-                        ++edges_across;
-                    }
-                    else {
-                        ++edges_within;
-                    }
-                    return true;
-                });
-                // check all of its edges across the partition
-                for_each_adjacent_side(side, [&](handle_t adj_side) {
-                    
-                    if (!partition.second.count(adj_side)) {
-                        // this edge is not across the partition, skip over it
-                        return true;
-                    }
-                    
-                    // count up the adjacent side's edges across and within
-                    int adj_edges_across = 0, adj_edges_within = 0;
-                    for_each_adjacent_side(adj_side, [&](handle_t adj_adj_side) {
-                        if (partition.first.count(adj_adj_side)) {
-                            ++adj_edges_across;
-                        }
-                        else {
-                            ++adj_edges_within;
-                        }
-                        return true;
-                    });
-                    
-                    // move if edge is in  Bylka, Idzik, & Tuza's S_3,
-                    // second component
-                    if (edges_within + adj_edges_within - edges_across - adj_edges_across >= -1) {
-                        // swapping the assignments of both ends of this edge will
-                        // improve the partition
-                        no_optimizations_left = false;
-                        partition.second.insert(side);
-                        partition.first.erase(side);
-                        partition.first.insert(adj_side);
-                        partition.second.erase(adj_side);
-                        ++opt_steps;
-                        
-#ifdef debug_refinement
-                        cerr << "found a local move by swapping edge " << graph->get_id(side) << " " << graph->get_is_reverse(side) << " -- " << graph->get_id(adj_side) << " " << graph->get_is_reverse(adj_side) << ", partition is now:" << endl;
-                        cerr << "left" << endl;
-                        for (auto h : partition.first) {
-                            cerr << "\t" << graph->get_id(h) << " " << graph->get_is_reverse(h) << endl;
-                        }
-                        cerr << "right" << endl;
-                        for (auto h : partition.second) {
-                            cerr << "\t" << graph->get_id(h) << " " << graph->get_is_reverse(h) << endl;
-                        }
-#endif
-                        
-                        // we can't keep iterating on this node's edges because it's
-                        // on the other side of the partition now
-                        return false;
-                    }
-                    // keep iterating
-                    return true;
-                });
+        while (!swap_worklist.empty() && opt_steps < max_opt_steps) {
+            size_t v = swap_worklist.back();
+            swap_worklist.pop_back();
+            in_swap_worklist[v] = false;
+            if (swap_edge(v)) {
+                ++opt_steps;
+                no_optimizations_left = false;
             }
         }
     }
 }
 
-uint64_t AdjacencyComponent::recursive_gray_code(bipartition& partition, uint64_t score,
-                                                 size_t index, size_t to_flip, uint64_t& best_score,
-                                                 uint64_t& best_index) const {
-    // recursively handle the indexes to the left
-    if (to_flip) {
-        score = recursive_gray_code(partition, score, index - (1 << (to_flip - 1)),
-                                    to_flip - 1, best_score, best_index);
+void AdjacencyComponent::refine_apx_partition(const AdjacencyEdgeArray& edges,
+                                              const vector<size_t>& active,
+                                              vector<bool>& on_left,
+                                              size_t max_opt_steps) const {
+    
+#ifdef debug_refinement
+    cerr << "doing local search to refine an approximate partition:" << endl;
+    for (size_t i : active) {
+        cerr << "\t" << graph->get_id(component[i]) << " " << graph->get_is_reverse(component[i]) << (on_left[i] ? " left" : " right") << endl;
     }
+#endif
     
-    // count how many edges are currently across or within the partition
-    bool on_left = partition.first.count(component[to_flip]);
-    uint64_t edges_within = 0, edges_across = 0;
-    for_each_adjacent_side(component[to_flip], [&](handle_t adj_side) {
-        bool adj_on_left = partition.first.count(adj_side);
-        if (on_left == adj_on_left) {
-            ++edges_within;
-        }
-        else {
-            ++edges_across;
-        }
-        return true;
-    });
+    GainBucketRefiner refiner(edges, active, on_left);
+    refiner.refine(max_opt_steps);
+    for (size_t k = 0; k < active.size(); ++k) {
+        on_left[active[k]] = refiner.is_on_left(k);
+    }
     
-    // switch the flipping side to the other part of the partition
-    if (on_left) {
-        partition.first.erase(component[to_flip]);
-        partition.second.insert(component[to_flip]);
+#ifdef debug_refinement
+    cerr << "refined partition:" << endl;
+    for (size_t i : active) {
+        cerr << "\t" << graph->get_id(component[i]) << " " << graph->get_is_reverse(component[i]) << (on_left[i] ? " left" : " right") << endl;
     }
-    else {
-        partition.second.erase(component[to_flip]);
-        partition.first.insert(component[to_flip]);
+#endif
+}
+
+size_t AdjacencyComponent::cut_size(const AdjacencyEdgeArray& edges, const vector<size_t>& active,
+                                    const vector<bool>& on_left) const {
+    size_t count = 0;
+    for (size_t i : active) {
+        if (on_left[i]) {
+            edges.for_each_edge(i, [&](size_t adj_side, size_t edge_id) {
+                count += !on_left[adj_side];
+            });
+        }
     }
-    // update the score for this side's edges
-    // TODO: this will break if there are reversing self-loops
-    score += edges_within - edges_across;
+    return count;
+}
+
+bipartition AdjacencyComponent::multi_start_maximum_bipartite_partition(size_t num_starts,
+                                                                        size_t num_threads,
+                                                                        size_t max_opt_steps) const {
     
-    if (score > best_score) {
-        // this is the best score we've seen so far
-        best_score = score;
-        best_index = index;
+    AdjacencyEdgeArray edges(*graph, component);
+    vector<size_t> active(component.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        active[i] = i;
     }
+    vector<bool> on_left(component.size(), false);
+    
+    multi_start_maximum_bipartite_partition(edges, active, on_left, max_opt_steps,
+                                            num_starts, num_threads);
+    
+    return to_bipartition(active, on_left);
+}
+
+void AdjacencyComponent::multi_start_maximum_bipartite_partition(const AdjacencyEdgeArray& edges,
+                                                                 const vector<size_t>& active,
+                                                                 vector<bool>& on_left,
+                                                                 size_t max_opt_steps,
+                                                                 size_t num_starts,
+                                                                 size_t num_threads) const {
     
-    // recursively handle the indexes to the right
-    if (to_flip) {
-        score = recursive_gray_code(partition, score, index + (1 << (to_flip - 1)),
-                                    to_flip - 1, best_score, best_index);
+    // the first start uses the same seed as a single start would, and the rest are derived
+    // from the sides that are being partitioned so that they don't depend on the order
+    // in which components are processed
+    uint64_t component_hash = 0;
+    for (size_t i : active) {
+        component_hash = splitmix64(component_hash ^ as_integer(component[i]));
+    }
+    vector<uint64_t> seeds(max<size_t>(num_starts, 1), default_apx_seed);
+    for (size_t k = 1; k < seeds.size(); ++k) {
+        seeds[k] = splitmix64(component_hash + k);
     }
     
-    return score;
+    vector<vector<bool>> partitions(seeds.size(), on_left);
+    vector<size_t> scores(seeds.size(), 0);
+    
+    atomic<size_t> next_start(0);
+    auto do_starts = [&]() {
+        for (size_t k = next_start.fetch_add(1); k < seeds.size(); k = next_start.fetch_add(1)) {
+            maximum_bipartite_partition_apx_1_2(edges, active, partitions[k], seeds[k]);
+            refine_apx_partition(edges, active, partitions[k], max_opt_steps);
+            scores[k] = cut_size(edges, active, partitions[k]);
+        }
+    };
+    
+    vector<thread> workers;
+    for (size_t t = 1; t < min(num_threads, seeds.size()); ++t) {
+        workers.emplace_back(do_starts);
+    }
+    do_starts();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    // take the best cut, breaking ties by the order of the starts
+    size_t best = 0;
+    for (size_t k = 1; k < seeds.size(); ++k) {
+        if (scores[k] > scores[best]) {
+            best = k;
+        }
+    }
+    on_left = move(partitions[best]);
 }
 
 bipartition AdjacencyComponent::exhaustive_maximum_bipartite_partition() const {
     
-    // a partition that we will maintain throughout iteration
-    bipartition partition;
-    partition.first.reserve(component.size());
-    partition.first.insert(component.begin(), component.end());
-    partition.second.reserve(component.size() - 1);
+    AdjacencyEdgeArray edges(*graph, component);
+    vector<size_t> active(component.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        active[i] = i;
+    }
+    vector<bool> on_left(component.size(), false);
     
-    uint64_t best_score = 0;
-    uint64_t best_index = 0;
+    exhaustive_maximum_bipartite_partition(edges, active, on_left);
     
-    if (component.size() > 1) {
-        // recursively iterate in order through a reflected binary Gray code (so that
-        // only one side be swapped in the partition per iteration)
-        recursive_gray_code(partition, 0, 1 << (component.size() - 2),
-                            component.size() - 2, best_score, best_index);
+    return to_bipartition(active, on_left);
+}
+
+void AdjacencyComponent::exhaustive_maximum_bipartite_partition(const AdjacencyEdgeArray& edges,
+                                                                const vector<size_t>& active,
+                                                                vector<bool>& on_left) const {
+    
+    if (active.size() > max_exhaustive_size_limit) {
+        throw runtime_error("ERROR: exhaustive bipartition is limited to " + to_string(max_exhaustive_size_limit)
+                            + " node sides, got " + to_string(active.size()));
     }
     
-    // reconstruct the partition that gave rise to the best score (conversion algorithm
-    // taken from https://en.wikipedia.org/wiki/Gray_code#Converting_to_and_from_Gray_code)
-    uint64_t best_gray_code = best_index ^ (best_index >> 1);
-    bipartition best_partition;
-    for (size_t i = 0; i < component.size(); ++i) {
-        if (best_gray_code & (1 << i)) {
-            best_partition.second.insert(component[i]);
-        }
-        else {
-            best_partition.first.insert(component[i]);
+    // encode the adjacencies of each side as a bitmask over the active sides
+    vector<size_t> local_index(edges.num_sides());
+    for (size_t k = 0; k < active.size(); ++k) {
+        local_index[active[k]] = k;
+    }
+    vector<uint64_t> adjacency(active.size(), 0);
+    for (size_t k = 0; k < active.size(); ++k) {
+        edges.for_each_edge(active[k], [&](size_t adj_side, size_t edge_id) {
+            if (adj_side != active[k]) {
+                // reversing self-loops are always within the partition, so we can leave them out
+                adjacency[k] |= (uint64_t(1) << local_index[adj_side]);
+            }
+        });
+    }
+    
+    // iterate in order through a reflected binary Gray code (so that only one side
+    // be swapped in the partition per iteration), holding the final side on the left
+    uint64_t right = 0;
+    int64_t score = 0;
+    int64_t best_score = 0;
+    uint64_t best_right = 0;
+    uint64_t num_codes = active.size() > 1 ? (uint64_t(1) << (active.size() - 1)) : 1;
+    for (uint64_t i = 1; i < num_codes; ++i) {
+        // the bit that changes in the Gray code is the lowest set bit of the index
+        uint64_t flip = uint64_t(1) << __builtin_ctzll(i);
+        uint64_t adj = adjacency[__builtin_ctzll(i)];
+        
+        // switching the side's part turns its edges within the partition into edges across
+        // and vice versa
+        int64_t edges_within = __builtin_popcountll(adj & ((right & flip) ? right : ~right));
+        int64_t edges_across = __builtin_popcountll(adj) - edges_within;
+        score += edges_within - edges_across;
+        right ^= flip;
+        
+        if (score > best_score) {
+            // this is the best score we've seen so far
+            best_score = score;
+            best_right = right;
         }
     }
-    return best_partition;
+    
+    for (size_t k = 0; k < active.size(); ++k) {
+        on_left[active[k]] = !(best_right & (uint64_t(1) << k));
+    }
 }
 
-void AdjacencyComponent::decompose_into_bipartite_blocks(const function<void(const BipartiteGraph&)>& lambda) const {
+void AdjacencyComponent::decompose_into_bipartite_blocks(const function<void(const BipartiteGraph&)>& lambda,
+                                                         size_t max_exhaustive_size,
+                                                         size_t num_cut_starts,
+                                                         size_t num_threads) const {
     
-    bipartition partition = bipartite_partition();
-    if (partition.first.size() + partition.second.size() == component.size()) {
-        // the whole component is bipartite, so there is only need for the one bipartite block
-        lambda(BipartiteGraph(*graph, partition));
+    AdjacencyEdgeArray edges(*graph, component);
+    
+    // the sides that still have edges that haven't been assigned to a block
+    vector<size_t> active(component.size());
+    for (size_t i = 0; i < active.size(); ++i) {
+        active[i] = i;
     }
-    else {
-        // TODO: magic constants
-        if (component.size() < 8) {
+    vector<bool> on_left(component.size(), false);
+    
+    // emit a block consisting of the edges across the partition
+    auto emit_block = [&](const vector<size_t>& block_sides) {
+        ordered_bipartition block_partition;
+        vector<size_t> right_index(component.size());
+        for (size_t i : block_sides) {
+            if (on_left[i]) {
+                block_partition.first.push_back(component[i]);
+            }
+            else {
+                right_index[i] = block_partition.second.size();
+                block_partition.second.push_back(component[i]);
+            }
+        }
+        vector<vector<size_t>> left_edges;
+        left_edges.reserve(block_partition.first.size());
+        for (size_t i : block_sides) {
+            if (on_left[i]) {
+                left_edges.emplace_back();
+                edges.for_each_edge(i, [&](size_t adj_side, size_t edge_id) {
+                    if (!on_left[adj_side]) {
+                        left_edges.back().push_back(right_index[adj_side]);
+                    }
+                });
+            }
+        }
+        lambda(BipartiteGraph(*graph, block_partition, left_edges));
+    };
+    
+    while (!active.empty()) {
+        
+        if (bipartite_partition(edges, active, on_left)) {
+            // the rest of the component is bipartite, so there is only need for the one
+            // more bipartite block
+            emit_block(active);
+            break;
+        }
+        
+        if (active.size() <= min<size_t>(max_exhaustive_size, max_exhaustive_size_limit)) {
             // the case is small enough to solve with brute force
-            partition = exhaustive_maximum_bipartite_partition();
+            exhaustive_maximum_bipartite_partition(edges, active, on_left);
         }
         else {
-            // start off with an approximate bipartition
-            partition = maximum_bipartite_partition_apx_1_2();
-            
-            // first iteration bound heuristically derived from Kaul & West (2008)
-            size_t max_opt_iters = min<size_t>(ceil(0.5 * pow(component.size(), 1.5)),
-                                               10 * component.size());
-            
-            // use greedy local search to find a locally optimal partition (or bail early)
-            refine_apx_partition(partition, max_opt_iters);
+            // start off with approximate bipartitions and use greedy local search to find
+            // locally optimal partitions
+            multi_start_maximum_bipartite_partition(edges, active, on_left,
+                                                    numeric_limits<size_t>::max(),
+                                                    num_cut_starts, num_threads);
         }
         
-        // divvy up the nodes and edges based on whether the edges are across
-        // the partition or not
-        SubtractiveHandleGraph partition_graph(*graph), remainder_graph(*graph);
-        unordered_set<handle_t> partition_sides, remainder_sides;
-        for (auto it = begin(), e = end(); it != e; ++it) {
-            handle_t side = *it;
-            bool on_left = partition.first.count(side);
-            for_each_adjacent_side(side, [&](handle_t adj_side) {
-                bool adj_on_left = partition.first.count(adj_side);
-                if (on_left == adj_on_left) {
+        // divvy up the sides based on whether their edges are across the partition or not
+        vector<bool> in_block(component.size(), false), in_remainder(component.size(), false);
+        for (size_t i : active) {
+            edges.for_each_edge(i, [&](size_t adj_side, size_t edge_id) {
+                if (on_left[i] == on_left[adj_side]) {
                     // this is a within partition edge
-                    remainder_sides.insert(side);
-                    remainder_sides.insert(adj_side);
-                    partition_graph.subtract_edge(side, graph->flip(adj_side));
+                    in_remainder[i] = true;
+                    in_remainder[adj_side] = true;
                 }
                 else {
                     // this is an across partition edge
-                    partition_sides.insert(side);
-                    partition_sides.insert(adj_side);
-                    remainder_graph.subtract_edge(side, graph->flip(adj_side));
+                    in_block[i] = true;
+                    in_block[adj_side] = true;
                 }
-                return true;
             });
         }
         
         // remove any sides from the partition that don't have any edges
         // that cross the partition
-        vector<handle_t> to_remove;
-        to_remove.reserve(component.size() - partition_sides.size());
-        for (auto it = begin(), e = end(); it != e; ++it) {
-            if (!partition_sides.count(*it)) {
-                to_remove.push_back(*it);
-            }
-        }
-        for (auto side : to_remove) {
-            if (partition.first.count(side)) {
-                partition.first.erase(side);
+        vector<size_t> block_sides, remainder_sides;
+        for (size_t i : active) {
+            if (in_block[i]) {
+                block_sides.push_back(i);
             }
-            else {
-                partition.second.erase(side);
+            if (in_remainder[i]) {
+                remainder_sides.push_back(i);
             }
         }
+        
+        if (block_sides.empty()) {
+            // the only edges left are reversing self-loops, which can't be part of
+            // any bipartite block
+            break;
+        }
+        
         // execute on the part of the component that we bipartitioned
-        lambda(BipartiteGraph(partition_graph, partition));
+        emit_block(block_sides);
         
-        // repeat the whole procedure again on the part of the component that we didn't
-        // manage to bipartition
-        AdjacencyComponent remainder_component(remainder_graph,
-                                               remainder_sides.begin(), remainder_sides.end());
-        remainder_component.decompose_into_bipartite_blocks(lambda);
+        // take the edges across the partition out of the graph and repeat the whole
+        // procedure again on the part of the component that we didn't manage to bipartition
+        for (size_t i : block_sides) {
+            if (on_left[i]) {
+                edges.for_each_edge(i, [&](size_t adj_side, size_t edge_id) {
+                    if (!on_left[adj_side]) {
+                        edges.remove_edge(edge_id);
+                    }
+                });
+            }
+        }
+        active = move(remainder_sides);
     }
 }
 
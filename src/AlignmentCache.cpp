@@ -0,0 +1,739 @@
+#include "AlignmentCache.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <tuple>
+#include <thread>
+#include <functional>
+#include <iterator>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+
+using handlegraph::edge_t;
+using std::lock_guard;
+using std::hash;
+using std::thread;
+using std::to_string;
+using std::tuple;
+using std::sort;
+using std::max;
+using std::prev;
+
+
+namespace {
+
+// Every entry file starts with this, and it changes whenever the entry format does
+const char entry_magic[8] = {'G','B','A','L','N','v','0','1'};
+const string entry_suffix = ".gba";
+
+// 64 bit FNV-1a, with a configurable offset basis so that two independent hashes can be combined
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ull){
+    for (size_t i = 0; i < size; i++){
+        hash ^= uint8_t(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <class T> void write_value(string& buffer, const T& value){
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Bounds-checked reading from a memory region, all reads fail once one of them has failed
+class BufferReader{
+public:
+    const char* data;
+    size_t size;
+    size_t position = 0;
+    bool failed = false;
+
+    BufferReader(const char* data, size_t size): data(data), size(size) {}
+
+    template <class T> T read_value(){
+        T value{};
+        if (failed or size - position < sizeof(T)){
+            failed = true;
+            return value;
+        }
+        memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    string read_string(uint64_t length){
+        if (failed or size - position < length){
+            failed = true;
+            return {};
+        }
+        string s(data + position, length);
+        position += length;
+        return s;
+    }
+
+    // Guard against absurd element counts before allocating for them
+    bool can_hold(uint64_t count, size_t element_size){
+        if (failed or count > (size - position) / element_size){
+            failed = true;
+        }
+        return not failed;
+    }
+};
+
+}
+
+
+namespace bluntifier {
+
+
+SubgraphTemplate::SubgraphTemplate(const Subgraph& subgraph){
+    auto& graph = subgraph.graph;
+
+    unordered_map <nid_t, uint64_t> node_indexes;
+
+    graph.for_each_handle([&](const handle_t& h){
+        node_indexes.emplace(graph.get_id(h), node_ids.size());
+        node_ids.emplace_back(graph.get_id(h));
+        node_sequences.emplace_back(graph.get_sequence(h));
+    });
+
+    auto encode = [&](const handle_t& h){
+        return 2*node_indexes.at(graph.get_id(h)) + graph.get_is_reverse(h);
+    };
+
+    graph.for_each_edge([&](const edge_t& e){
+        edges.emplace_back(encode(e.first), encode(e.second));
+    });
+
+    subgraph.for_each_path([&](const PathInfo& path_info){
+        if (path_info.spoa_id >= paths.size()){
+            paths.resize(path_info.spoa_id + 1);
+        }
+
+        for (auto h: graph.scan_path(path_info.path_handle)){
+            paths[path_info.spoa_id].emplace_back(encode(h));
+        }
+    });
+}
+
+
+SubgraphTemplate::SubgraphTemplate(OverlapAligner& overlap_aligner, const vector<string>& sequences){
+    // The aligners don't depend on which handles the paths belong to
+    Subgraph subgraph;
+    subgraph.create_sequence_paths(sequences.size());
+
+    overlap_aligner.align(sequences, subgraph);
+
+    *this = SubgraphTemplate(subgraph);
+}
+
+
+void SubgraphTemplate::instantiate(Subgraph& subgraph) const{
+    auto& graph = subgraph.graph;
+
+    vector <handle_t> handles;
+    handles.reserve(node_sequences.size());
+
+    for (size_t n = 0; n < node_ids.size(); n++){
+        handles.emplace_back(graph.create_handle(node_sequences[n], node_ids[n]));
+    }
+
+    auto decode = [&](uint64_t h){
+        return (h & 1) ? graph.flip(handles[h >> 1]) : handles[h >> 1];
+    };
+
+    for (auto& e: edges){
+        graph.create_edge(decode(e.first), decode(e.second));
+    }
+
+    subgraph.for_each_path([&](const PathInfo& path_info){
+        for (auto h: paths.at(path_info.spoa_id)){
+            graph.append_step(path_info.path_handle, decode(h));
+        }
+    });
+}
+
+
+uint64_t SubgraphTemplate::get_size() const{
+    // Each string and vector also has a fixed overhead of about 32 bytes
+    uint64_t size = sizeof(SubgraphTemplate) + node_ids.size()*(sizeof(nid_t) + 32) + edges.size()*16;
+
+    for (auto& sequence: node_sequences){
+        size += sequence.size();
+    }
+
+    for (auto& path: paths){
+        size += 32 + path.size()*sizeof(uint64_t);
+    }
+
+    return size;
+}
+
+
+bool SubgraphTemplate::is_valid_for(const vector<string>& sequences) const{
+    if (node_ids.size() != node_sequences.size() or paths.size() != sequences.size()){
+        return false;
+    }
+
+    uint64_t n_handles = 2*node_ids.size();
+
+    for (auto& e: edges){
+        if (e.first >= n_handles or e.second >= n_handles){
+            return false;
+        }
+    }
+
+    for (size_t p = 0; p < paths.size(); p++){
+        size_t length = 0;
+
+        for (auto h: paths[p]){
+            // Paths of aligned subgraphs only traverse nodes forward
+            if (h >= n_handles or (h & 1)){
+                return false;
+            }
+
+            auto& node_sequence = node_sequences[h >> 1];
+            if (sequences[p].compare(length, node_sequence.size(), node_sequence) != 0){
+                return false;
+            }
+            length += node_sequence.size();
+        }
+
+        if (length != sequences[p].size()){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void SubgraphTemplate::serialize(string& buffer) const{
+    write_value(buffer, uint64_t(node_ids.size()));
+    for (size_t n = 0; n < node_ids.size(); n++){
+        write_value(buffer, int64_t(node_ids[n]));
+        write_value(buffer, uint64_t(node_sequences[n].size()));
+        buffer += node_sequences[n];
+    }
+
+    write_value(buffer, uint64_t(edges.size()));
+    for (auto& e: edges){
+        write_value(buffer, e.first);
+        write_value(buffer, e.second);
+    }
+
+    write_value(buffer, uint64_t(paths.size()));
+    for (auto& path: paths){
+        write_value(buffer, uint64_t(path.size()));
+        for (auto h: path){
+            write_value(buffer, h);
+        }
+    }
+}
+
+
+bool SubgraphTemplate::deserialize(const char* data, size_t size){
+    BufferReader reader(data, size);
+
+    auto n_nodes = reader.read_value<uint64_t>();
+    if (not reader.can_hold(n_nodes, 2*sizeof(uint64_t))){
+        return false;
+    }
+
+    node_ids.resize(n_nodes);
+    node_sequences.resize(n_nodes);
+    for (size_t n = 0; n < n_nodes and not reader.failed; n++){
+        node_ids[n] = reader.read_value<int64_t>();
+        node_sequences[n] = reader.read_string(reader.read_value<uint64_t>());
+    }
+
+    auto n_edges = reader.read_value<uint64_t>();
+    if (not reader.can_hold(n_edges, 2*sizeof(uint64_t))){
+        return false;
+    }
+
+    edges.resize(n_edges);
+    for (auto& e: edges){
+        e.first = reader.read_value<uint64_t>();
+        e.second = reader.read_value<uint64_t>();
+    }
+
+    auto n_paths = reader.read_value<uint64_t>();
+    if (not reader.can_hold(n_paths, sizeof(uint64_t))){
+        return false;
+    }
+
+    paths.resize(n_paths);
+    for (auto& path: paths){
+        auto n_steps = reader.read_value<uint64_t>();
+        if (not reader.can_hold(n_steps, sizeof(uint64_t))){
+            return false;
+        }
+
+        path.resize(n_steps);
+        for (auto& h: path){
+            h = reader.read_value<uint64_t>();
+        }
+    }
+
+    return not reader.failed and reader.position == size;
+}
+
+
+string AlignmentCache::make_key(const string& aligner_description, const vector<string>& sequences){
+    size_t key_length = aligner_description.size() + 1;
+    for (auto& sequence: sequences){
+        key_length += sequence.size() + 21;
+    }
+
+    string key;
+    key.reserve(key_length);
+    key += aligner_description;
+    key += '\0';
+
+    // Lengths are included so that the boundaries between sequences are unambiguous
+    for (auto& sequence: sequences){
+        key += to_string(sequence.size());
+        key += ':';
+        key += sequence;
+    }
+
+    return key;
+}
+
+
+pair <uint64_t, uint64_t> AlignmentCache::hash_key(const string& key){
+    // Two independent 64 bit hashes
+    return {fnv1a(key.data(), key.size()), fnv1a(key.data(), key.size(), 0x9e3779b97f4a7c15ull)};
+}
+
+
+string AlignmentCache::get_entry_path(const pair <uint64_t, uint64_t>& key_hash) const{
+    // The full key is stored in the entry and compared when it is loaded
+    char name[33];
+    snprintf(name, sizeof(name), "%016llx%016llx",
+             (unsigned long long) key_hash.first, (unsigned long long) key_hash.second);
+
+    return join_paths(directory, string(name) + entry_suffix);
+}
+
+
+void AlignmentCache::open_directory(const string& directory, uint64_t max_directory_bytes){
+    if (mkdir(directory.c_str(), 0755) != 0 and errno != EEXIST){
+        throw runtime_error("ERROR: could not create alignment cache directory: " + directory);
+    }
+
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0 or not S_ISDIR(info.st_mode)){
+        throw runtime_error("ERROR: alignment cache path is not a directory: " + directory);
+    }
+
+    this->directory = directory;
+    this->max_directory_bytes = max_directory_bytes;
+}
+
+
+void AlignmentCache::set_max_memory_bytes(uint64_t max_memory_bytes){
+    this->max_memory_bytes = max_memory_bytes;
+}
+
+
+bool AlignmentCache::load_from_directory(
+        const string& key,
+        const pair <uint64_t, uint64_t>& key_hash,
+        const vector<string>& sequences,
+        SubgraphTemplate& subgraph_template){
+
+    auto path = get_entry_path(key_hash);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0){
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 or info.st_size == 0){
+        close(fd);
+        return false;
+    }
+
+    size_t size = info.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED){
+        return false;
+    }
+
+    // Entry layout: magic, key length, key, template length, template, checksum of everything before it
+    auto data = static_cast<const char*>(mapped);
+    BufferReader reader(data, size);
+
+    bool valid = (reader.read_string(sizeof(entry_magic)) == string(entry_magic, sizeof(entry_magic)));
+    valid = valid and reader.read_string(reader.read_value<uint64_t>()) == key;
+
+    auto template_size = reader.read_value<uint64_t>();
+    valid = valid and reader.can_hold(template_size, 1);
+
+    size_t template_start = reader.position;
+    reader.position += valid ? template_size : 0;
+
+    size_t checksum_start = reader.position;
+    auto checksum = reader.read_value<uint64_t>();
+
+    valid = valid and not reader.failed and reader.position == size;
+    valid = valid and checksum == fnv1a(data, checksum_start);
+    valid = valid and subgraph_template.deserialize(data + template_start, template_size);
+    valid = valid and subgraph_template.is_valid_for(sequences);
+
+    munmap(mapped, size);
+
+    if (valid){
+        // Mark the entry as recently used, for eviction
+        utime(path.c_str(), nullptr);
+    }
+
+    return valid;
+}
+
+
+void AlignmentCache::store_in_directory(
+        const string& key,
+        const pair <uint64_t, uint64_t>& key_hash,
+        const SubgraphTemplate& subgraph_template){
+
+    auto path = get_entry_path(key_hash);
+
+    string template_buffer;
+    subgraph_template.serialize(template_buffer);
+
+    string buffer;
+    buffer.append(entry_magic, sizeof(entry_magic));
+    write_value(buffer, uint64_t(key.size()));
+    buffer += key;
+    write_value(buffer, uint64_t(template_buffer.size()));
+    buffer += template_buffer;
+    write_value(buffer, fnv1a(buffer.data(), buffer.size()));
+
+    // Write to a temporary file first and then rename it, so that other processes never see a partial entry
+    auto thread_hash = hash<thread::id>()(std::this_thread::get_id());
+    auto temp_path = path + "." + to_string(getpid()) + "." + to_string(thread_hash) + ".tmp";
+
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){
+        return;
+    }
+
+    size_t written = 0;
+    while (written < buffer.size()){
+        auto n = write(fd, buffer.data() + written, buffer.size() - written);
+        if (n <= 0){
+            break;
+        }
+        written += n;
+    }
+
+    bool ok = (close(fd) == 0 and written == buffer.size());
+
+    if (not ok or rename(temp_path.c_str(), path.c_str()) != 0){
+        unlink(temp_path.c_str());
+    }
+}
+
+
+bool AlignmentCache::store_in_memory(
+        const pair <uint64_t, uint64_t>& key_hash,
+        const string& aligner_description,
+        SubgraphTemplate&& subgraph_template,
+        bool is_pinned,
+        size_t pinned_until){
+
+    uint64_t size = subgraph_template.get_size() + aligner_description.size();
+
+    // A colliding or outdated entry is replaced
+    auto result = entries.find(key_hash);
+    if (result != entries.end()){
+        memory_bytes -= result->second.size;
+
+        if (result->second.is_pinned){
+            pinned_bytes -= result->second.size;
+            pin_order.erase(result->second.pin_position);
+        }
+        else{
+            lru_order.erase(result->second.lru_position);
+        }
+
+        entries.erase(result);
+    }
+
+    while (memory_bytes + size > max_memory_bytes and not lru_order.empty()){
+        auto& entry = entries.at(lru_order.back());
+        memory_bytes -= entry.size;
+
+        entries.erase(lru_order.back());
+        lru_order.pop_back();
+    }
+
+    // Everything that is left is pinned (or this entry is bigger than the limit)
+    if (memory_bytes + size > max_memory_bytes){
+        return false;
+    }
+
+    auto& entry = entries[key_hash];
+    entry.aligner_description = aligner_description;
+    entry.subgraph_template = std::move(subgraph_template);
+    entry.size = size;
+    entry.is_pinned = is_pinned;
+
+    if (is_pinned){
+        pinned_bytes += size;
+        entry.pin_position = pin_order.emplace(pinned_until, key_hash);
+    }
+    else{
+        lru_order.emplace_front(key_hash);
+        entry.lru_position = lru_order.begin();
+    }
+
+    memory_bytes += size;
+    peak_memory_bytes = max(peak_memory_bytes, memory_bytes);
+
+    return true;
+}
+
+
+bool AlignmentCache::load(
+        const string& aligner_description,
+        const vector<string>& sequences,
+        Subgraph& subgraph){
+
+    auto key = make_key(aligner_description, sequences);
+    auto key_hash = hash_key(key);
+
+    {
+        lock_guard<mutex> lock(cache_mutex);
+
+        auto result = entries.find(key_hash);
+        if (result != entries.end()
+            and result->second.aligner_description == aligner_description
+            and result->second.subgraph_template.is_valid_for(sequences)){
+
+            auto& entry = result->second;
+            entry.subgraph_template.instantiate(subgraph);
+
+            // Mark the entry as recently used, and make it evictable if it was stored ahead of time. Using a result
+            // that was computed ahead of time doesn't avoid any alignment, so it is counted separately
+            if (entry.is_pinned){
+                unpin_entry(key_hash, entry, true);
+
+                n_pinned_hits++;
+            }
+            else{
+                lru_order.splice(lru_order.begin(), lru_order, entry.lru_position);
+
+                n_hits++;
+                for (auto& sequence: sequences){
+                    n_bases_avoided += sequence.size();
+                }
+            }
+
+            return true;
+        }
+    }
+
+    if (directory.empty()){
+        return false;
+    }
+
+    SubgraphTemplate subgraph_template;
+    if (not load_from_directory(key, key_hash, sequences, subgraph_template)){
+        return false;
+    }
+
+    subgraph_template.instantiate(subgraph);
+
+    lock_guard<mutex> lock(cache_mutex);
+
+    n_hits++;
+    n_disk_hits++;
+    for (auto& sequence: sequences){
+        n_bases_avoided += sequence.size();
+    }
+
+    store_in_memory(key_hash, aligner_description, std::move(subgraph_template), false, 0);
+
+    return true;
+}
+
+
+bool AlignmentCache::contains(const string& aligner_description, const vector<string>& sequences){
+    auto key_hash = hash_key(make_key(aligner_description, sequences));
+
+    {
+        lock_guard<mutex> lock(cache_mutex);
+
+        if (entries.count(key_hash) > 0){
+            return true;
+        }
+    }
+
+    struct stat info;
+    return not directory.empty() and stat(get_entry_path(key_hash).c_str(), &info) == 0;
+}
+
+
+bool AlignmentCache::store(
+        const string& aligner_description,
+        const vector<string>& sequences,
+        SubgraphTemplate subgraph_template,
+        bool is_pinned,
+        size_t pinned_until){
+
+    auto key = make_key(aligner_description, sequences);
+    auto key_hash = hash_key(key);
+
+    if (not directory.empty()){
+        store_in_directory(key, key_hash, subgraph_template);
+    }
+
+    lock_guard<mutex> lock(cache_mutex);
+
+    return store_in_memory(key_hash, aligner_description, std::move(subgraph_template), is_pinned, pinned_until);
+}
+
+
+void AlignmentCache::unpin_entry(const pair <uint64_t, uint64_t>& key_hash, Entry& entry, bool is_used){
+    entry.is_pinned = false;
+    pinned_bytes -= entry.size;
+    pin_order.erase(entry.pin_position);
+
+    // Entries that were never used are the first to go
+    if (is_used){
+        lru_order.emplace_front(key_hash);
+        entry.lru_position = lru_order.begin();
+    }
+    else{
+        lru_order.emplace_back(key_hash);
+        entry.lru_position = prev(lru_order.end());
+    }
+}
+
+
+void AlignmentCache::unpin(size_t position){
+    lock_guard<mutex> lock(cache_mutex);
+
+    while (not pin_order.empty() and pin_order.begin()->first < position){
+        auto key_hash = pin_order.begin()->second;
+        unpin_entry(key_hash, entries.at(key_hash), false);
+    }
+}
+
+
+bool AlignmentCache::has_room(){
+    lock_guard<mutex> lock(cache_mutex);
+
+    return pinned_bytes < max_memory_bytes;
+}
+
+
+bool AlignmentCache::align(OverlapAligner& overlap_aligner, const vector<string>& sequences, Subgraph& subgraph){
+    auto aligner_description = overlap_aligner.describe();
+
+    if (load(aligner_description, sequences, subgraph)){
+        return true;
+    }
+
+    SubgraphTemplate subgraph_template(overlap_aligner, sequences);
+    subgraph_template.instantiate(subgraph);
+
+    store(aligner_description, sequences, std::move(subgraph_template));
+
+    return false;
+}
+
+
+void AlignmentCache::evict(){
+    if (directory.empty()){
+        return;
+    }
+
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr){
+        return;
+    }
+
+    // (last modification, size, path) of each entry
+    vector <tuple <time_t, uint64_t, string> > entries;
+    uint64_t total_bytes = 0;
+
+    while (auto entry = readdir(dir)){
+        string name = entry->d_name;
+
+        if (name.size() <= entry_suffix.size()
+            or name.compare(name.size() - entry_suffix.size(), entry_suffix.size(), entry_suffix) != 0){
+            continue;
+        }
+
+        auto path = join_paths(directory, name);
+
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0 and S_ISREG(info.st_mode)){
+            entries.emplace_back(info.st_mtime, info.st_size, path);
+            total_bytes += info.st_size;
+        }
+    }
+
+    closedir(dir);
+
+    sort(entries.begin(), entries.end());
+
+    for (auto& entry: entries){
+        if (total_bytes <= max_directory_bytes){
+            break;
+        }
+
+        if (unlink(std::get<2>(entry).c_str()) == 0){
+            total_bytes -= std::get<1>(entry);
+        }
+    }
+}
+
+
+uint64_t AlignmentCache::get_n_hits() const{
+    return n_hits;
+}
+
+
+uint64_t AlignmentCache::get_n_disk_hits() const{
+    return n_disk_hits;
+}
+
+
+uint64_t AlignmentCache::get_n_pinned_hits() const{
+    return n_pinned_hits;
+}
+
+
+uint64_t AlignmentCache::get_n_bases_avoided() const{
+    return n_bases_avoided;
+}
+
+
+uint64_t AlignmentCache::get_memory_bytes() const{
+    return memory_bytes;
+}
+
+
+uint64_t AlignmentCache::get_peak_memory_bytes() const{
+    return peak_memory_bytes;
+}
+
+
+}
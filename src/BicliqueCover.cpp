@@ -21,7 +21,8 @@ using std::tuple;
 using std::cerr;
 using std::endl;
 
-BicliqueCover::BicliqueCover(const BipartiteGraph& graph) : graph(graph) {
+BicliqueCover::BicliqueCover(const BipartiteGraph& graph, size_t num_threads)
+    : graph(graph), num_threads(num_threads) {
 
 #ifdef debug_biclique_cover
     cerr << "initializing biclique cover for graph:" << endl;
@@ -53,7 +54,7 @@ vector<bipartition> BicliqueCover::get() const {
     // attempt the exact solution for domino-free graphs
     vector<pair<handle_t, vector<handle_t>>> simplifications;
     BipartiteGraph simplified = graph.simplify(simplifications);
-    GaloisLattice galois_lattice(simplified);
+    GaloisLattice galois_lattice(simplified, num_threads);
     if (galois_lattice.is_domino_free()) {
 #ifdef debug_biclique_cover
         cerr << "graph is domino free" << endl;
@@ -23,30 +23,30 @@ BipartiteGraph::BipartiteGraph(const HandleGraph& graph,
     // sort to remove system dependent behavior
     sort(_partition.first.begin(), _partition.first.end());
     sort(_partition.second.begin(), _partition.second.end());
-    // map the handles back to their index as well
-    left_partition_index.reserve(_partition.first.size());
-    right_partition_index.reserve(_partition.second.size());
-    for (size_t i = 0; i < _partition.first.size(); ++i) {
-        left_partition_index[_partition.first[i]] = i;
-    }
+    // make local adjacency lists
+    unordered_map<handle_t, size_t> right_index;
+    right_index.reserve(_partition.second.size());
     for (size_t i = 0; i < _partition.second.size(); ++i) {
-        right_partition_index[_partition.second[i]] = i;
+        right_index[_partition.second[i]] = i;
     }
-    // make local adjacency lists
     left_edges.resize(_partition.first.size());
-    right_edges.resize(_partition.second.size());
     for (size_t i = 0; i < _partition.first.size(); ++i) {
         graph.follow_edges(_partition.first[i], false, [&](const handle_t& right) {
-            auto j = right_partition_index[graph.flip(right)];
-            left_edges[i].push_back(j);
-            right_edges[j].push_back(i);
+            left_edges[i].push_back(right_index[graph.flip(right)]);
         });
     }
+    index_partition();
 }
 
 BipartiteGraph::BipartiteGraph(const HandleGraph& graph,
-                               const ordered_bipartition& partition) : graph(&graph), _partition(partition)
+                               const ordered_bipartition& partition,
+                               const vector<vector<size_t>>& left_edges)
+    : graph(&graph), _partition(partition), left_edges(left_edges)
 {
+    index_partition();
+}
+
+void BipartiteGraph::index_partition() {
     // map the handles back to their index as well
     left_partition_index.reserve(_partition.first.size());
     right_partition_index.reserve(_partition.second.size());
@@ -56,15 +56,12 @@ BipartiteGraph::BipartiteGraph(const HandleGraph& graph,
     for (size_t i = 0; i < _partition.second.size(); ++i) {
         right_partition_index[_partition.second[i]] = i;
     }
-    // make local adjacency lists
-    left_edges.resize(_partition.first.size());
+    // make the reverse adjacency lists
     right_edges.resize(_partition.second.size());
-    for (size_t i = 0; i < _partition.first.size(); ++i) {
-        graph.follow_edges(_partition.first[i], false, [&](const handle_t& right) {
-            auto j = right_partition_index[graph.flip(right)];
-            left_edges[i].push_back(j);
+    for (size_t i = 0; i < left_edges.size(); ++i) {
+        for (size_t j : left_edges[i]) {
             right_edges[j].push_back(i);
-        });
+        }
     }
 }
 
@@ -134,7 +131,7 @@ void BipartiteGraph::for_each_adjacent_side(const handle_t& side,
 }
 
 BipartiteGraph BipartiteGraph::simplify(vector<pair<handle_t, vector<handle_t>>>& simplifications) const {
-    BipartiteGraph simplifying(*graph, _partition);
+    BipartiteGraph simplifying(*this);
     simplifying.simplify_side(simplifying._partition.first, simplifying._partition.second,
                               simplifying.left_edges, simplifying.right_edges, simplifications);
     simplifying.simplify_side(simplifying._partition.second, simplifying._partition.first,
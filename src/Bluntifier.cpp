@@ -1,6 +1,7 @@
 #include "Bluntifier.hpp"
 
 using std::to_string;
+using std::min;
 
 namespace bluntifier{
 
@@ -12,15 +13,42 @@ ProvenanceInfo::ProvenanceInfo(size_t start, size_t stop, bool reversal):
 {}
 
 
+Prealignment::Prealignment(size_t biclique_index, OverlapAligner* overlap_aligner, vector<string>&& sequences):
+    biclique_index(biclique_index),
+    overlap_aligner(overlap_aligner),
+    sequences(std::move(sequences))
+{}
+
+
 Bluntifier::Bluntifier(const string& gfa_path,
                        const string& provenance_path,
-                       bool verbose):
+                       bool verbose,
+                       size_t max_exhaustive_size,
+                       size_t num_cut_starts,
+                       size_t n_threads,
+                       const string& aligner_name,
+                       bool adaptive_poa,
+                       size_t min_windowed_overlap_length,
+                       const string& align_cache_directory,
+                       uint64_t align_cache_max_bytes):
     gfa_path(gfa_path),
     provenance_path(provenance_path),
-    verbose(verbose)
+    verbose(verbose),
+    max_exhaustive_size(max_exhaustive_size),
+    num_cut_starts(num_cut_starts),
+    n_threads(n_threads),
+    aligner_name(aligner_name),
+    spoa_aligner(new SpoaAligner(adaptive_poa, SpoaAligner::default_max_single_pass_divergence, n_threads)),
+    wavefront_aligner(new WavefrontAligner(*spoa_aligner)),
+    min_windowed_overlap_length(min_windowed_overlap_length),
+    windowed_aligner(new WindowedAligner(*spoa_aligner, n_threads))
 {
     // start our clock
     time(&time_start);
+
+    if (not align_cache_directory.empty()){
+        alignment_cache.open_directory(align_cache_directory, align_cache_max_bytes);
+    }
 }
 
 void Bluntifier::log_progress(const string& msg) const {
@@ -116,7 +144,7 @@ void Bluntifier::compute_biclique_cover(size_t i){
     }
 
     adjacency_component.decompose_into_bipartite_blocks([&](const BipartiteGraph& bipartite_graph){
-        vector <bipartition> biclique_cover = BicliqueCover(bipartite_graph).get();
+        vector <bipartition> biclique_cover = BicliqueCover(bipartite_graph, n_threads).get();
         vector <vector <edge_t> > deduplicated_biclique_cover;
 
         // TODO: find a lock-minimal thread safe way to prevent copying each biclique cover during duplication
@@ -130,7 +158,7 @@ void Bluntifier::compute_biclique_cover(size_t i){
             bicliques.bicliques.emplace_back(biclique);
             biclique_mutex.unlock();
         }
-    });
+    }, max_exhaustive_size, num_cut_starts, n_threads);
 }
 
 
@@ -160,82 +188,80 @@ void Bluntifier::map_splice_sites_by_node(){
 }
 
 
-tuple <bool, bool> Bluntifier::is_oo_node(nid_t node_id){
-    bool is_oo_child = false;
-    bool is_oo_parent = false;
+vector <bool> Bluntifier::find_overlapping_overlap_bicliques() const{
+    vector <bool> is_oo_biclique(bicliques.size(), false);
 
-    // Check if this is an Overlapping Overlap node
-    auto is_child_result = child_to_parent.find(node_id);
-
-    if (is_child_result != child_to_parent.end()){
-        auto original_gfa_node = is_child_result->second.first;
-        bool is_terminus = is_child_result->second.second;
-
-        auto result = overlapping_overlap_nodes.find(original_gfa_node);
-        if (result != overlapping_overlap_nodes.end()) {
-            auto& overlap_info = result->second;
-
-            // Check if this node is part of the non-terminal parent material in this OO node
-            if (not is_terminus) {
-                auto parent_path = gfa_graph.get_path_handle(overlap_info.parent_path_name);
-
-                for (auto h: gfa_graph.scan_path(parent_path)) {
-                    if (gfa_graph.get_id(h) == node_id) {
-                        is_oo_parent = true;
-                    }
-                }
+    for (auto& overlap_info: overlapping_overlap_nodes){
+        for (auto side: {0, 1}){
+            for (auto& child: overlap_info.overlapping_children[side]){
+                is_oo_biclique[child.second.biclique_index] = true;
             }
-            else {
-                // Brute force search of overlapping children in this OO node to see if this is one of the overlaps
-                // that was excluded from splicing
-                for (auto s: {0, 1}) {
-                    for (auto& oo_item: overlap_info.overlapping_children[s]) {
-                        if (gfa_graph.get_id(oo_item.second.handle) == node_id) {
-                            is_oo_child = true;
-                        }
-                    }
-                }
+            for (auto& child: overlap_info.normal_children[side]){
+                is_oo_biclique[child.second.biclique_index] = true;
             }
         }
     }
 
-    return {is_oo_parent, is_oo_child};
+    return is_oo_biclique;
 }
 
 
-void Bluntifier::splice_subgraphs(){
-    size_t i = 0;
-    for (auto& subgraph: subgraphs) {
+void Bluntifier::splice_subgraphs(const vector<CompactSubgraph>& subgraphs){
+    // Reserve a range of node IDs for each subgraph up front. This gives the same IDs as inserting them one at a time
+    // after the max ID so far
+    vector <nid_t> id_offsets;
+    id_offsets.reserve(subgraphs.size());
+
+    nid_t id_offset = gfa_graph.max_node_id();
+
+    for (auto& subgraph: subgraphs){
+        id_offsets.emplace_back(id_offset);
+        id_offset += subgraph.get_max_node_id();
+    }
+
+    vector <vector <handle_t> > handles;
+    handles.reserve(subgraphs.size());
+
+    for (size_t k = 0; k < subgraphs.size(); k++){
+        handles.emplace_back(subgraphs[k].insert_nodes(gfa_graph, id_offsets[k]));
+    }
 
-        // First, copy the subgraph into the GFA graph
-        subgraph.graph.increment_node_ids(gfa_graph.max_node_id());
-        copy_path_handle_graph(&subgraph.graph, &gfa_graph);
+    // Find the edges from the parents of each terminus to the ends of its path before creating any of them. A parent
+    // can itself be a terminus that is spliced later on, so the edges found so far are kept as an overlay on the graph,
+    // which makes the result the same as splicing one subgraph at a time
+    vector <vector <edge_t> > splice_edges(subgraphs.size());
+    unordered_map <handle_t, vector <handle_t> > planned_successors;
 
-        i++;
+    for (size_t k = 0; k < subgraphs.size(); k++){
+        auto& subgraph = subgraphs[k];
 
         // Iterate the suffixes/prefixes that participated in this biclique
         for (bool side: {0, 1}) {
             for (auto& item: subgraph.paths_per_handle[side]) {
                 auto& handle = item.first;
-                auto& path_info = item.second;
                 auto node_id = gfa_graph.get_id(handle);
 
                 bool is_oo_parent;
                 bool is_oo_child;
-                tie(is_oo_parent, is_oo_child) = is_oo_node(node_id);
+                tie(is_oo_parent, is_oo_child) = overlapping_overlap_index.get_roles(node_id);
 
                 if (not is_oo_child) {
-
-                    // Find the path handle for the path that was copied into the GFA graph
-                    auto path_name = subgraph.graph.get_path_name(path_info.path_handle);
-                    auto path_handle = gfa_graph.get_path_handle(path_name);
-
                     set<handle_t> parent_handles;
-                    gfa_graph.follow_edges(handle, 1 - side, [&](const handle_t& h) {
-                        if (to_be_destroyed.count(gfa_graph.get_id(h)) == 0) {
+                    auto add_parent = [&](const handle_t& h) {
+                        if (not is_dropped(gfa_graph.get_id(h))) {
                             parent_handles.emplace(h);
                         }
-                    });
+                    };
+
+                    gfa_graph.follow_edges(handle, 1 - side, add_parent);
+
+                    // Parents to the left of a handle are the flipped successors of its flipped handle
+                    auto planned = planned_successors.find(side == 0 ? gfa_graph.flip(handle) : handle);
+                    if (planned != planned_successors.end()) {
+                        for (auto& h: planned->second) {
+                            add_parent(side == 0 ? gfa_graph.flip(h) : h);
+                        }
+                    }
 
                     if (parent_handles.empty() and not is_oo_parent) {
                         throw runtime_error("ERROR: biclique terminus does not have any parent: " + to_string(node_id));
@@ -244,30 +270,38 @@ void Bluntifier::splice_subgraphs(){
                     for (auto& parent_handle: parent_handles) {
                         // Depending on which side of the biclique this node is on, its path in the POA will be spliced
                         // differently
-                        if (path_info.biclique_side == 0) {
-                            auto& left = parent_handle;
-                            auto right = gfa_graph.get_handle_of_step(gfa_graph.path_begin(path_handle));
-
-                            gfa_graph.create_edge(left, right);
+                        edge_t edge;
+                        if (side == 0) {
+                            edge = {parent_handle, subgraph.get_path_front(item.second, gfa_graph, handles[k])};
                         } else {
-                            auto left = gfa_graph.get_handle_of_step(gfa_graph.path_back(path_handle));
-                            auto& right = parent_handle;
-
-                            gfa_graph.create_edge(left, right);
+                            edge = {subgraph.get_path_back(item.second, gfa_graph, handles[k]), parent_handle};
                         }
+
+                        splice_edges[k].emplace_back(edge);
+                        planned_successors[edge.first].emplace_back(edge.second);
+                        planned_successors[gfa_graph.flip(edge.second)].emplace_back(gfa_graph.flip(edge.first));
                     }
                 }
                 else{
-//                    cerr << "Skipping oo child: " << node_id << '\n';
+//                cerr << "Skipping oo child: " << node_id << '\n';
                 }
 
-                if (subgraph.paths_per_handle[1-side].count(handle) == 0
-                    and subgraph.paths_per_handle[1-side].count(gfa_graph.flip(handle)) == 0) {
-                    to_be_destroyed.emplace(gfa_graph.get_id(handle));
+                if (subgraph.find_path(1-side, handle) < 0
+                    and subgraph.find_path(1-side, gfa_graph.flip(handle)) < 0) {
+                    drop_node(gfa_graph.get_id(handle));
                 }
             }
         }
     }
+
+    // Create the edges in the same order as splicing one subgraph at a time would
+    for (size_t k = 0; k < subgraphs.size(); k++){
+        subgraphs[k].insert_edges_and_paths(gfa_graph, handles[k]);
+
+        for (auto& edge: splice_edges[k]){
+            gfa_graph.create_edge(edge.first, edge.second);
+        }
+    }
 }
 
 
@@ -283,11 +317,6 @@ void Bluntifier::write_provenance(){
 
     file << "#bluntified_sequence\tinput_sequences" << endl;
     for (auto& [child_node, parents]: provenance_map){
-        
-        if (to_be_destroyed.count(child_node)) {
-            // no need to write provenance for nodes that will be removed from the graph
-            continue;
-        }
         file << child_node << '\t';
 
         auto iter = parents.begin();
@@ -328,6 +357,13 @@ void Bluntifier::update_path_provenances(
         auto id = gfa_graph.get_id(h);
         size_t length = gfa_graph.get_length(h);
 
+        // No need to keep provenance for nodes that are left out of the output
+        if (is_dropped(id)){
+            parent_index += length;
+            cumulative_path_length += length;
+            continue;
+        }
+
         size_t forward_start_index;
         size_t forward_stop_index;
 
@@ -355,6 +391,20 @@ void Bluntifier::update_path_provenances(
 }
 
 
+void Bluntifier::drop_node(nid_t node_id){
+    if (size_t(node_id) >= dropped_nodes.size()){
+        dropped_nodes.resize(node_id + 1, false);
+    }
+
+    dropped_nodes[node_id] = true;
+}
+
+
+bool Bluntifier::is_dropped(nid_t node_id) const{
+    return size_t(node_id) < dropped_nodes.size() and dropped_nodes[node_id];
+}
+
+
 void Bluntifier::compute_provenance(){
     for (int64_t parent_node_id=1; parent_node_id <= id_map.names.size(); parent_node_id++){
         string parent_path_name = to_string(parent_node_id);
@@ -371,7 +421,7 @@ void Bluntifier::compute_provenance(){
             parent_length += length;
 
             // Check if this is a duplicated prefix/suffix
-            if (child_to_parent.count(id) > 0){
+            if (parentage.is_child(id)){
                 if (i == 0){
                     has_left_child = true;
                 }
@@ -381,7 +431,7 @@ void Bluntifier::compute_provenance(){
                 }
             }
             // Store the provenance info for this node if it's not a terminus/child
-            else if (to_be_destroyed.count(id) == 0){
+            else if (not is_dropped(id)){
                 ProvenanceInfo info(parent_index, parent_index + length - 1, false);
                 provenance_map[id].emplace(parent_node_id, info);
             }
@@ -397,7 +447,7 @@ void Bluntifier::compute_provenance(){
         // and biclique harmonization will have randomly flipped the edges
         NodeInfo node_info(
                 node_to_biclique_edge,
-                child_to_parent,
+                parentage,
                 bicliques,
                 gfa_graph,
                 overlaps,
@@ -430,7 +480,7 @@ void Bluntifier::compute_provenance(){
                 bool reversal;
                 bool parent_side;
 
-                if (child_to_parent.at(gfa_graph.get_id(canonical_edge.first)).first == parent_node_id){
+                if (parentage.get_parent(gfa_graph.get_id(canonical_edge.first)).first == parent_node_id){
                     reversal = gfa_graph.get_is_reverse(canonical_edge.first);
 
                     if (reversal){
@@ -467,7 +517,7 @@ void Bluntifier::compute_provenance(){
 
                 }
                 // Its possible for the same edge to be on both "sides" of a node if it is a loop
-                if (child_to_parent.at(gfa_graph.get_id(canonical_edge.second)).first == parent_node_id){
+                if (parentage.get_parent(gfa_graph.get_id(canonical_edge.second)).first == parent_node_id){
                     reversal = gfa_graph.get_is_reverse(canonical_edge.second);
 
                     if (reversal){
@@ -510,8 +560,8 @@ void Bluntifier::compute_provenance(){
 }
 
 
-void Bluntifier::bluntify(){
-    
+void Bluntifier::duplicate_termini(){
+
     log_progress("Reading GFA...");
 
     gfa_to_handle_graph(gfa_path, gfa_graph, id_map, overlaps);
@@ -536,35 +586,122 @@ void Bluntifier::bluntify(){
 
     map_splice_sites_by_node();
 
+    // The overlap sequences are already known, so POA doesn't need to wait for the termini to be duplicated
+    log_progress("Aligning overlaps in the background...");
+
+    vector<thread> prealignment_workers;
+    start_prealignment(prealignment_workers);
+
     Duplicator super_duper(
             node_to_biclique_edge,
             overlaps,
             bicliques,
-            parent_to_children,
-            child_to_parent,
+            parentage,
             overlapping_overlap_nodes);
 
     log_progress("Duplicating node termini...");
 
     super_duper.duplicate_all_node_termini(gfa_graph);
+    parentage.index_children();
 
     log_progress("Harmonizing biclique edge orientations...");
 
     harmonize_biclique_orientations();
 
-    log_progress("Aligning overlaps...");
+    for (auto& worker: prealignment_workers){
+        worker.join();
+    }
+
+    log_progress("Aligned " + to_string(n_prealigned) + " of " + to_string(prealignments.size())
+                 + " bicliques in the background");
 
-    subgraphs.resize(bicliques.size());
+    // Predictions that weren't aligned are not needed anymore, the results are only looked up through the cache
+    prealignments.clear();
+    prealignments.shrink_to_fit();
+
+    // Splicing needs to know which termini belong to overlapping overlap nodes, and these don't change from here on
+    overlapping_overlap_index = OverlappingOverlapIndex(gfa_graph, parentage, overlapping_overlap_nodes);
+}
+
+
+const HashGraph& Bluntifier::get_graph() const{
+    return gfa_graph;
+}
+
+
+const Parentage& Bluntifier::get_parentage() const{
+    return parentage;
+}
+
+
+const OverlappingOverlapNodes& Bluntifier::get_overlapping_overlap_nodes() const{
+    return overlapping_overlap_nodes;
+}
 
-    for (size_t i=0; i<bicliques.size(); i++){
-        align_biclique_overlaps(i);
-    }
 
-    log_progress("Splicing " + to_string(subgraphs.size()) + " subgraphs...");
+const AlignmentCache& Bluntifier::get_alignment_cache() const{
+    return alignment_cache;
+}
+
+
+uint64_t Bluntifier::get_n_prealigned() const{
+    return n_prealigned;
+}
+
+
+void Bluntifier::bluntify(){
+
+    duplicate_termini();
+
+    log_progress("Aligning and splicing overlaps...");
 
-    splice_subgraphs();
+    // Subgraphs are spliced in batches as soon as they are aligned, so only one batch is held at a time. Aligning
+    // doesn't read anything that splicing modifies, and subgraphs are still spliced in biclique order
+    auto is_oo_biclique = find_overlapping_overlap_bicliques();
+    spliced_paths.resize(bicliques.size());
 
-    OverlappingOverlapSplicer oo_splicer(overlapping_overlap_nodes, parent_to_children, subgraphs);
+    for (size_t start = 0; start < bicliques.size(); start += splice_batch_size){
+        auto stop = min(start + splice_batch_size, bicliques.size());
+
+        vector <CompactSubgraph> batch;
+        batch.reserve(stop - start);
+
+        for (size_t i=start; i<stop; i++){
+            batch.emplace_back(align_biclique_overlaps(i));
+        }
+
+        splice_subgraphs(batch);
+
+        // Alignments made in the background for these bicliques won't be loaded anymore if they haven't been already
+        alignment_cache.unpin(stop);
+
+        for (size_t i=start; i<stop; i++){
+            if (is_oo_biclique[i]){
+                spliced_paths[i] = SplicedPaths(batch[i - start]);
+            }
+        }
+    }
+
+    alignment_cache.evict();
+
+    log_progress("Used " + to_string(alignment_cache.get_n_pinned_hits()) + " of the " + to_string(n_prealigned)
+                 + " alignments made in the background");
+    log_progress("Reused " + to_string(alignment_cache.get_n_hits()) + " cached alignments ("
+                 + to_string(alignment_cache.get_n_disk_hits()) + " from disk), avoiding "
+                 + to_string(alignment_cache.get_n_bases_avoided()) + " bp of alignment, and holding at most "
+                 + to_string(alignment_cache.get_peak_memory_bytes()/1024) + " KiB in memory");
+    log_progress("POA used a single pass for " + to_string(spoa_aligner->get_n_single_pass()) + " bicliques (saving ~"
+                 + to_string(spoa_aligner->get_seconds_saved()) + " s) and two passes for "
+                 + to_string(spoa_aligner->get_n_two_pass()) + ", building "
+                 + to_string(spoa_aligner->get_n_poa_nodes()) + " POA nodes");
+    log_progress("Aligned the second POA pass of " + to_string(spoa_aligner->get_n_frozen())
+                 + " large bicliques to a frozen seeded graph");
+    log_progress("Gave " + to_string(wavefront_aligner->get_n_fallbacks())
+                 + " bicliques that were too divergent for wavefront alignment to POA");
+    log_progress("Aligned " + to_string(windowed_aligner->get_n_windowed()) + " long overlaps in "
+                 + to_string(windowed_aligner->get_n_windows()) + " windows");
+
+    OverlappingOverlapSplicer oo_splicer(overlapping_overlap_nodes, parentage, spliced_paths, n_threads);
 
     log_progress("Splicing overlapping overlap nodes...");
 
@@ -581,16 +718,13 @@ void Bluntifier::bluntify(){
         write_provenance();
     }
 
-    log_progress("Destroying duplicated nodes...");
+    log_progress("Writing bluntified GFA to file to STDOUT, without the duplicated nodes");
 
-    for (auto& id: to_be_destroyed){
-        // TODO: remove node from provenance map?
-        gfa_graph.destroy_handle(gfa_graph.get_handle(id));
-    }
-    
-    log_progress("Writing bluntified GFA to file to STDOUT");
-
-    handle_graph_to_gfa(gfa_graph, cout);
+    // Skipping the duplicated nodes while writing is a single pass, whereas destroying each of them would update the
+    // edges and paths of its neighbors one node at a time
+    handle_graph_to_gfa(gfa_graph, cout, [&](nid_t node_id){
+        return is_dropped(node_id);
+    });
 
     // Output an image of the graph, can be uncommented for debugging
 //    {
@@ -1,8 +1,10 @@
 #include "Bluntifier.hpp"
 #include "handle_to_gfa.hpp"
 #include "unchop.hpp"
+#include <algorithm>
 #include <array>
 #include <map>
+#include <set>
 
 using handlegraph::HandleGraph;
 using handlegraph::nid_t;
@@ -13,6 +15,10 @@ using std::to_string;
 using std::string;
 using std::array;
 using std::map;
+using std::pair;
+using std::max;
+using std::set;
+using std::make_pair;
 
 using handlegraph::nid_t;
 
@@ -31,121 +37,6 @@ handle_t& get_side(edge_t& e, bool side){
 
 
 
-void Bluntifier::convert_spoa_to_bdsg(Graph& spoa_graph, size_t i){
-    auto& paths = spoa_graph.sequences();
-    unordered_map <uint32_t, handle_t> nodes_created;
-    handle_t previous_subgraph_handle;
-
-    for (size_t side: {0,1}){
-        for (auto& item: subgraphs[i].paths_per_handle[side]){
-            auto& gfa_handle = item.first;
-            PathInfo& path_info = item.second;
-
-            // This points to the first SPOA node within the path that this sequence aligned to in the SPOA graph
-            auto node = paths[path_info.spoa_id];
-
-            size_t base_index = 0;
-
-            while (true) {
-                // Check if this node has already been copied to the BDSGraph
-                auto iter = nodes_created.find(node->id);
-
-                if (iter == nodes_created.end()) {
-                    char base = gfa_graph.get_base(gfa_handle, base_index);
-
-                    auto new_subgraph_handle = subgraphs[i].graph.create_handle(string(1, base));
-                    nodes_created.emplace(node->id, new_subgraph_handle);
-
-                    if (base_index > 0) {
-                        subgraphs[i].graph.create_edge(previous_subgraph_handle, new_subgraph_handle);
-                    }
-
-                    previous_subgraph_handle = new_subgraph_handle;
-                }
-                else{
-                    if (base_index > 0) {
-                        subgraphs[i].graph.create_edge(previous_subgraph_handle, iter->second);
-                    }
-
-                    previous_subgraph_handle = iter->second;
-                }
-
-                subgraphs[i].graph.append_step(path_info.path_handle, previous_subgraph_handle);
-
-                base_index++;
-
-                // Check if the spoa path has ended
-                if (!(node = node->Successor(path_info.spoa_id))) {
-                    break;
-                }
-            }
-        }
-    }
-}
-
-
-void Bluntifier::add_alignments_to_poa(
-        Graph& spoa_graph,
-        unique_ptr<AlignmentEngine>& alignment_engine,
-        size_t i){
-
-    // Since alignment may be done twice (for iterative POA), path data might need to be cleared
-    subgraphs[i].paths_per_handle[0].clear();
-    subgraphs[i].paths_per_handle[1].clear();
-
-    // If the graph already has some sequences in it, then start the id at that number
-    uint32_t spoa_id = spoa_graph.sequences().size();
-
-    // Treating the biclique subgraph as an object with sides, add alignments, and keep track of the paths through which
-    // the left and right handles traverse so they can be used for splicing later
-    for (auto& edge: bicliques[i]){
-        if (subgraphs[i].paths_per_handle[0].count(edge.first) == 0){
-            string path_name = to_string(gfa_graph.get_id(edge.first)) + "_" + to_string(0);
-
-            path_handle_t path_handle;
-
-            // Paths might exist from previous alignment, but will be empty
-            if (not subgraphs[i].graph.has_path(path_name)){
-                path_handle = subgraphs[i].graph.create_path_handle(path_name);
-            }
-            else{
-                path_handle = subgraphs[i].graph.get_path_handle(path_name);
-            }
-
-            PathInfo path_info(path_handle, spoa_id++, 0);
-
-            subgraphs[i].paths_per_handle[0].emplace(edge.first, path_info);
-            auto sequence = gfa_graph.get_sequence(edge.first);
-
-            auto alignment = alignment_engine->Align(sequence, spoa_graph);
-            spoa_graph.AddAlignment(alignment, sequence);
-        }
-        if (subgraphs[i].paths_per_handle[1].count(edge.second) == 0){
-            string path_name = to_string(gfa_graph.get_id(edge.second)) + "_" + to_string(1);
-
-            path_handle_t path_handle;
-
-            // Paths might exist from previous alignment, but will be empty
-            if (not subgraphs[i].graph.has_path(path_name)){
-                path_handle = subgraphs[i].graph.create_path_handle(path_name);
-            }
-            else{
-                path_handle = subgraphs[i].graph.get_path_handle(path_name);
-            }
-
-            PathInfo path_info(path_handle, spoa_id++, 1);
-
-            subgraphs[i].paths_per_handle[1].emplace(edge.second, path_info);
-
-            auto sequence = gfa_graph.get_sequence(edge.second);
-
-            auto alignment = alignment_engine->Align(sequence, spoa_graph);
-            spoa_graph.AddAlignment(alignment, sequence);
-        }
-    }
-}
-
-
 bool Bluntifier::biclique_overlaps_are_exact(size_t i){
     bool exact = true;
 
@@ -189,10 +80,10 @@ bool Bluntifier::biclique_overlaps_are_exact(size_t i){
 }
 
 
-void Bluntifier::create_exact_subgraph(size_t i) {
+void Bluntifier::create_exact_subgraph(size_t i, Subgraph& subgraph) {
     // For an exact biclique the alignment is trivial, just pick one of the suffixes/prefixes
     auto sequence = gfa_graph.get_sequence(bicliques[i][0].first);
-    auto new_subgraph_handle = subgraphs[i].graph.create_handle(sequence);
+    auto new_subgraph_handle = subgraph.graph.create_handle(sequence);
 
     // Treating the biclique subgraph as an object with sides, add alignments, and keep track of the paths through which
     // the left and right handles traverse so they can be used for splicing later
@@ -210,181 +101,551 @@ void Bluntifier::create_exact_subgraph(size_t i) {
             path_handle_t path_handle;
 
             // The same handle can branch into multiple edges within a biclique, so dont add it twice
-            if (not subgraphs[i].graph.has_path(path_name)) {
-                path_handle = subgraphs[i].graph.create_path_handle(path_name);
-                subgraphs[i].graph.append_step(path_handle, new_subgraph_handle);
+            if (not subgraph.graph.has_path(path_name)) {
+                path_handle = subgraph.graph.create_path_handle(path_name);
+                subgraph.graph.append_step(path_handle, new_subgraph_handle);
 
                 PathInfo path_info(path_handle, 0, side);
-                subgraphs[i].paths_per_handle[side].emplace(h, path_info);
+                subgraph.paths_per_handle[side].emplace(h, path_info);
             }
         }
     }
 }
 
 
-void Bluntifier::align_biclique_overlaps(size_t i){
-    // TODO: switch to fetch_add atomic
+bool Bluntifier::create_subgraph_from_cigars(size_t i, Subgraph& subgraph) {
+    // Find the distinct handles on each side of the biclique
+    array <vector <handle_t>, 2> handles_per_side;
+    for (auto& edge: bicliques[i]) {
+        for (size_t side: {0, 1}) {
+            auto& h = get_side(edge, side);
+            if (find(handles_per_side[side].begin(), handles_per_side[side].end(), h) == handles_per_side[side].end()) {
+                handles_per_side[side].emplace_back(h);
+            }
+        }
+    }
 
-    // Skip trivial bicliques
-    if (bicliques[i].empty()){
-        return;
+    // Only single edges and stars can be built from pairwise alignments alone
+    size_t center_side;
+    if (handles_per_side[0].size() == 1) {
+        center_side = 0;
+    }
+    else if (handles_per_side[1].size() == 1) {
+        center_side = 1;
+    }
+    else {
+        return false;
     }
 
-    if (biclique_overlaps_are_exact(i)){
-        create_exact_subgraph(i);
+    handle_t center = handles_per_side[center_side][0];
+    string center_sequence = gfa_graph.get_sequence(center);
+
+    // Orient each edge's CIGAR so that the center is the ref, and check that it spans the leaf completely and fits
+    // inside the center
+    vector <vector <Cigar> > edge_operations;
+    vector <size_t> center_starts;
+    for (auto& edge: bicliques[i]) {
+        auto iter = overlaps.canonicalize_and_find(edge, gfa_graph);
+
+        if (iter == overlaps.overlaps.end()){
+            throw runtime_error("ERROR: edge not found in overlaps: "
+                                + to_string(gfa_graph.get_id(edge.first)) + "->"
+                                + to_string(gfa_graph.get_id(edge.second)));
+        }
+
+        edge_operations.emplace_back(iter->second.operations);
+        auto& operations = edge_operations.back();
+
+        // The overlap may be stored on the reverse strand, in which case the ref is the right side, and the ref is
+        // also the right side if that is where the center is. If both are true they cancel out.
+        bool reversed = (iter->first != edge);
+        if (reversed) {
+            reverse(operations.begin(), operations.end());
+        }
+        if (reversed != (center_side == 1)) {
+            for (auto& c: operations) {
+                if (c.type() == 'I') {
+                    c = Cigar(c.length, 'D');
+                }
+                else if (c.type() == 'D') {
+                    c = Cigar(c.length, 'I');
+                }
+            }
+        }
+
+        size_t center_length = 0;
+        size_t leaf_length = 0;
+        for (auto& c: operations) {
+            char type = c.type();
+            if (type == 'M' or type == '=' or type == 'X') {
+                center_length += c.length;
+                leaf_length += c.length;
+            }
+            else if (type == 'D') {
+                center_length += c.length;
+            }
+            else if (type == 'I') {
+                leaf_length += c.length;
+            }
+            else {
+                return false;
+            }
+        }
+
+        if (center_length > center_sequence.size()
+            or leaf_length != gfa_graph.get_length(get_side(edge, 1 - center_side))) {
+            return false;
+        }
+
+        // The center is a suffix on the left side, and a prefix on the right side
+        size_t center_start = center_side == 0 ? center_sequence.size() - center_length : 0;
+        center_starts.emplace_back(center_start);
+
+        // GFA CIGARs are not always correct, so check the aligned bases before trusting one. The leaf has to share the
+        // center's terminal base where the overlap meets the rest of the center, otherwise its path is disconnected
+        // from the center's after splicing
+        string leaf_sequence = gfa_graph.get_sequence(get_side(edge, 1 - center_side));
+        size_t center_index = center_start;
+        size_t leaf_index = 0;
+        size_t n_matched = 0;
+        size_t n_mismatched = 0;
+        size_t n_columns = 0;
+        bool first_column_matches = false;
+        bool last_column_matches = false;
+
+        for (auto& c: operations) {
+            char type = c.type();
+
+            for (size_t k = 0; k < c.length; k++) {
+                bool is_column_match = false;
+
+                if (type == 'M' or type == '=' or type == 'X') {
+                    is_column_match = (leaf_sequence[leaf_index] == center_sequence[center_index]);
+                    n_matched += is_column_match;
+                    n_mismatched += not is_column_match;
+                    leaf_index++;
+                    center_index++;
+                }
+                else if (type == 'D') {
+                    center_index++;
+                }
+                else {
+                    leaf_index++;
+                }
+
+                if (n_columns++ == 0) {
+                    first_column_matches = is_column_match;
+                }
+                last_column_matches = is_column_match;
+            }
+        }
+
+        bool terminal_matches = (center_side == 0) ? last_column_matches : first_column_matches;
+
+        if (not terminal_matches
+            or double(n_mismatched) > max_cigar_mismatch_fraction * double(n_matched + n_mismatched)) {
+            return false;
+        }
+    }
+
+    BackboneGraph backbone_graph(center_sequence, subgraph.graph);
+
+    // Keep track of the order the sequences would have been given to an OverlapAligner in
+    uint32_t spoa_id = 0;
+
+    for (size_t e = 0; e < bicliques[i].size(); e++) {
+        auto& edge = bicliques[i][e];
+
+        for (size_t side: {0, 1}) {
+            auto h = get_side(edge, side);
+            if (subgraph.paths_per_handle[side].count(h)) {
+                continue;
+            }
+
+            string path_name = to_string(gfa_graph.get_id(h)) + "_" + to_string(side);
+            auto path_handle = subgraph.graph.create_path_handle(path_name);
+            subgraph.paths_per_handle[side].emplace(h, PathInfo(path_handle, spoa_id++, side));
+
+            if (side == center_side) {
+                backbone_graph.add_backbone_path(path_handle);
+            }
+            else {
+                backbone_graph.add_path(path_handle, gfa_graph.get_sequence(h), edge_operations[e], center_starts[e]);
+            }
+        }
+    }
+
+    unchop(&subgraph.graph);
+
+    return true;
+}
+
+
+double Bluntifier::estimate_overlap_divergence(size_t i){
+    uint64_t n_edits = 0;
+    uint64_t n_aligned = 0;
+
+    for (auto& edge: bicliques[i]){
+        auto iter = overlaps.canonicalize_and_find(edge, gfa_graph);
+
+        if (iter == overlaps.overlaps.end()){
+            throw runtime_error("ERROR: edge not found in overlaps: "
+                                + to_string(gfa_graph.get_id(edge.first)) + "->"
+                                + to_string(gfa_graph.get_id(edge.second)));
+        }
+
+        pair<size_t,size_t> lengths;
+        iter->second.compute_lengths(lengths);
+
+        auto ref_start = gfa_graph.get_length(iter->first.first) - lengths.first;
+        auto explicit_cigar_operations = iter->second.explicitize_mismatches(gfa_graph, iter->first, ref_start, 0);
+
+        for (auto& c: explicit_cigar_operations){
+            if (c.type() != '=') {
+                n_edits += c.length;
+            }
+            n_aligned += c.length;
+        }
+    }
+
+    if (n_aligned == 0){
+        return 0;
+    }
+
+    return double(n_edits)/double(n_aligned);
+}
+
+
+OverlapAligner* Bluntifier::select_overlap_aligner(size_t i, const vector<string>& sequences){
+    string name = aligner_name;
+    if (name == "auto"){
+        name = estimate_overlap_divergence(i) <= WavefrontAligner::default_max_divergence ? "wfa" : "spoa";
+    }
+
+    size_t max_length = 0;
+    for (auto& sequence: sequences){
+        max_length = max(max_length, sequence.size());
+    }
+
+    if (name == "wfa"){
+        return wavefront_aligner.get();
+    }
+    else if (min_windowed_overlap_length > 0 and max_length >= min_windowed_overlap_length){
+        // Full DP on very long overlaps is quadratic, so split them at shared anchors
+        return windowed_aligner.get();
     }
     else {
-        auto alignment_engine = spoa::AlignmentEngine::Create(spoa::AlignmentType::kSW, 5, -3, -3, -1);
+        return spoa_aligner.get();
+    }
+}
 
-        spoa::Graph spoa_graph{};
 
-        add_alignments_to_poa(spoa_graph, alignment_engine, i);
+bool Bluntifier::predict_overlap_sequences(size_t i, vector<string>& sequences){
+    if (bicliques[i].empty() or biclique_overlaps_are_exact(i)){
+        return false;
+    }
 
-        auto consensus = spoa_graph.GenerateConsensus();
+    // The edges are reoriented (as harmonize_biclique_orientations will) before anything depends on which side of
+    // them each node is on
+    auto biclique = get_harmonized_edges(bicliques[i]);
 
-        spoa::Graph seeded_spoa_graph{};
+    // Single edges and stars are built from their CIGARs
+    array <set <handle_t>, 2> handles_per_side;
+    for (auto& edge: biclique){
+        for (size_t side: {0, 1}){
+            handles_per_side[side].emplace(get_side(edge, side));
+        }
+    }
 
-        auto seeded_alignment_engine = spoa::AlignmentEngine::Create(spoa::AlignmentType::kSW, 6, -2, -4, -1);
+    if (handles_per_side[0].size() == 1 or handles_per_side[1].size() == 1){
+        return false;
+    }
 
-        auto alignment = seeded_alignment_engine->Align(consensus, seeded_spoa_graph);
-        seeded_spoa_graph.AddAlignment(alignment, consensus);
+    // Each side of a node gets one terminus per biclique, as long as its longest overlap in the biclique
+    map <pair <nid_t, bool>, size_t> extents;
 
-        // Iterate a second time on alignment, this time with consensus as the seed
-        add_alignments_to_poa(seeded_spoa_graph, alignment_engine, i);
+    for (auto& edge: biclique){
+        auto iter = overlaps.canonicalize_and_find(edge, gfa_graph);
+
+        pair<size_t,size_t> lengths;
+        iter->second.compute_lengths(lengths);
 
-        convert_spoa_to_bdsg(seeded_spoa_graph, i);
+        if (iter->first != edge){
+            std::swap(lengths.first, lengths.second);
+        }
 
-        unchop(&subgraphs[i].graph);
+        for (size_t side: {0, 1}){
+            auto& extent = extents[get_node_side(get_side(edge, side), side)];
+            extent = max(extent, side == 0 ? lengths.first : lengths.second);
+        }
     }
+
+    // The duplicated terminus spells the end of the handle on the left side of the edges, and the start of it on the
+    // right side
+    array <set <handle_t>, 2> handles_found;
+
+    for (auto& edge: biclique){
+        for (size_t side: {0, 1}){
+            auto& h = get_side(edge, side);
+
+            if (handles_found[side].emplace(h).second){
+                auto sequence = gfa_graph.get_sequence(h);
+                auto extent = extents.at(get_node_side(h, side));
+
+                if (side == 0){
+                    sequences.emplace_back(sequence.substr(sequence.size() - extent));
+                }
+                else{
+                    sequences.emplace_back(sequence.substr(0, extent));
+                }
+            }
+        }
+    }
+
+    return true;
 }
 
 
+void Bluntifier::start_prealignment(vector<thread>& workers){
+    // Everything that reads the graph happens here, before the termini are duplicated
+    for (size_t i = 0; i < bicliques.size(); i++){
+        vector<string> sequences;
 
-/// For all the edges in a biclique, reorient them by matching the majority orientation of the node with the most
-/// edges. In the case where there is no such orientation, pick arbitrarily
-void Bluntifier::harmonize_biclique_orientations(){
-    for (auto& biclique: bicliques.bicliques){
-        if (biclique.size() < 2){
+        if (predict_overlap_sequences(i, sequences)){
+            auto overlap_aligner = select_overlap_aligner(i, sequences);
+            prealignments.emplace_back(i, overlap_aligner, std::move(sequences));
+        }
+    }
+
+    // The aligners' own threads run serially within these, so that no more than n_threads are aligning at once
+    start_parallel_workers(n_threads, [this](){
+        prealign_overlaps();
+    }, workers);
+}
+
+
+void Bluntifier::prealign_overlaps(){
+    for (size_t k = next_prealignment.fetch_add(1); k < prealignments.size(); k = next_prealignment.fetch_add(1)){
+        auto& prealignment = prealignments[k];
+        auto overlap_aligner = prealignment.overlap_aligner;
+        auto& sequences = prealignment.sequences;
+
+        // Repeated bicliques only need to be aligned once
+        if (alignment_cache.contains(overlap_aligner->describe(), sequences)){
+            vector<string>().swap(sequences);
             continue;
         }
 
-        map <nid_t, array<uint64_t, 2> > n_edges_per_node;
-        map <nid_t, vector<size_t> > primary_edge_indexes;
+        // Results are held until they are used, so stop once they would fill the cache. The rest are aligned when
+        // they are needed
+        if (not alignment_cache.has_room()){
+            break;
+        }
 
-        uint64_t max_edges = 0;
-        nid_t max_node;
+        // An entry that doesn't fit anymore means the cache is full
+        SubgraphTemplate subgraph_template(*overlap_aligner, sequences);
+        bool is_stored = alignment_cache.store(
+                overlap_aligner->describe(), sequences, std::move(subgraph_template), true, prealignment.biclique_index);
 
-        for (size_t edge_index=0; edge_index<biclique.size(); edge_index++){
-            auto& edge = biclique[edge_index];
+        if (not is_stored){
+            break;
+        }
 
-            nid_t left_node = gfa_graph.get_id(edge.first);
-            nid_t right_node = gfa_graph.get_id(edge.second);
+        // The cache has its own copy of the sequences, in the template's nodes
+        vector<string>().swap(sequences);
 
-            auto iter_left = n_edges_per_node.find(left_node);
-            auto iter_right = n_edges_per_node.find(right_node);
+        n_prealigned++;
+    }
+}
 
-            // If the node has not been traversed yet, add a data container
-            if (iter_left == n_edges_per_node.end()){
-                array<uint64_t,2> a = {0,0};
-                iter_left = n_edges_per_node.emplace(left_node, a).first;
-            }
-            if (iter_right == n_edges_per_node.end()){
-                array<uint64_t,2> a = {0,0};
-                iter_right = n_edges_per_node.emplace(right_node, a).first;
-            }
 
-            // Update the counts for F and R orientations
-            iter_left->second[gfa_graph.get_is_reverse(edge.first)]++;
-            iter_right->second[gfa_graph.get_is_reverse(edge.second)]++;
+CompactSubgraph Bluntifier::align_biclique_overlaps(size_t i){
+    // TODO: switch to fetch_add atomic
 
-            uint64_t total_left = iter_left->second[0] + iter_left->second[1];
-            uint64_t total_right = iter_right->second[0] + iter_right->second[1];
+    // Skip trivial bicliques
+    if (bicliques[i].empty()){
+        return {};
+    }
 
-            // Update the max observed edges
-            if (total_left > max_edges){
-                max_edges = total_left;
-                max_node = left_node;
-            }
-            if (total_right > max_edges){
-                max_edges = total_right;
-                max_node = right_node;
+    Subgraph subgraph;
+
+    if (biclique_overlaps_are_exact(i)){
+        create_exact_subgraph(i, subgraph);
+    }
+    else if (not create_subgraph_from_cigars(i, subgraph)){
+        // Single edges and stars don't need POA, the overlap CIGARs are already the alignment. For everything else,
+        // treating the biclique subgraph as an object with sides, create a path for each handle on each side so that
+        // they can be used for splicing later. The path info records the index of the handle's sequence
+        vector <string> sequences;
+
+        for (auto& edge: bicliques[i]){
+            for (size_t side: {0, 1}){
+                auto& h = get_side(edge, side);
+
+                if (subgraph.paths_per_handle[side].count(h) == 0){
+                    string path_name = to_string(gfa_graph.get_id(h)) + "_" + to_string(side);
+                    auto path_handle = subgraph.graph.create_path_handle(path_name);
+
+                    PathInfo path_info(path_handle, sequences.size(), side);
+                    subgraph.paths_per_handle[side].emplace(h, path_info);
+
+                    sequences.emplace_back(gfa_graph.get_sequence(h));
+                }
             }
+        }
+
+        auto overlap_aligner = select_overlap_aligner(i, sequences);
+
+        // Bicliques with identical sequences (e.g. from repeats or a previous run) only need to be aligned once
+        alignment_cache.align(*overlap_aligner, sequences, subgraph);
+    }
+
+    // Only the flattened graph is kept until splicing, the HashGraph is freed here
+    return CompactSubgraph(subgraph);
+}
+
+
+
+pair <nid_t, bool> Bluntifier::get_node_side(const handle_t& h, size_t side) const{
+    return make_pair(gfa_graph.get_id(h), gfa_graph.get_is_reverse(h) == bool(side));
+}
+
 
-            primary_edge_indexes[left_node].emplace_back(edge_index);
-            primary_edge_indexes[right_node].emplace_back(edge_index);
+/// For all the edges in a biclique, reorient them by matching the majority orientation of the node side with the most
+/// edges. In the case where there is no such orientation, pick arbitrarily. Node sides are used instead of nodes so that
+/// the result is the same before and after the termini are duplicated, when each node side becomes its own child
+vector <edge_t> Bluntifier::get_harmonized_edges(const vector<edge_t>& edges) const{
+    auto biclique = edges;
+
+    if (biclique.size() < 2){
+        return biclique;
+    }
+
+    map <pair <nid_t, bool>, array<uint64_t, 2> > n_edges_per_node;
+    map <pair <nid_t, bool>, vector<size_t> > primary_edge_indexes;
+
+    uint64_t max_edges = 0;
+    pair <nid_t, bool> max_node;
+
+    for (size_t edge_index=0; edge_index<biclique.size(); edge_index++){
+        auto& edge = biclique[edge_index];
+
+        auto left_node = get_node_side(edge.first, 0);
+        auto right_node = get_node_side(edge.second, 1);
+
+        auto iter_left = n_edges_per_node.find(left_node);
+        auto iter_right = n_edges_per_node.find(right_node);
+
+        // If the node has not been traversed yet, add a data container
+        if (iter_left == n_edges_per_node.end()){
+            array<uint64_t,2> a = {0,0};
+            iter_left = n_edges_per_node.emplace(left_node, a).first;
+        }
+        if (iter_right == n_edges_per_node.end()){
+            array<uint64_t,2> a = {0,0};
+            iter_right = n_edges_per_node.emplace(right_node, a).first;
         }
 
-        // Decide what orientation to use for the seed node
-        auto max_edge_info = n_edges_per_node.at(max_node);
-        auto n_reverse = max_edge_info[1];
-        auto n_forward = max_edge_info[0];
+        // Update the counts for F and R orientations
+        iter_left->second[gfa_graph.get_is_reverse(edge.first)]++;
+        iter_right->second[gfa_graph.get_is_reverse(edge.second)]++;
 
-        bool seed_majority_reversal = false;
-        if (n_reverse > n_forward){
-            seed_majority_reversal = true;
+        uint64_t total_left = iter_left->second[0] + iter_left->second[1];
+        uint64_t total_right = iter_right->second[0] + iter_right->second[1];
+
+        // Update the max observed edges
+        if (total_left > max_edges){
+            max_edges = total_left;
+            max_node = left_node;
+        }
+        if (total_right > max_edges){
+            max_edges = total_right;
+            max_node = right_node;
         }
 
-        // Iterate the edges directly linked with the seed node and flip them if necessary
-        // Additionally flip (as necessary) all the secondary edges that stem from the seed node's adjacent nodes
-        for (auto i: primary_edge_indexes.at(max_node)){
-            auto& edge = biclique[i];
-            size_t seed_side;
+        primary_edge_indexes[left_node].emplace_back(edge_index);
+        primary_edge_indexes[right_node].emplace_back(edge_index);
+    }
 
-            if (gfa_graph.get_id(edge.first) == max_node){
-                seed_side = 0;
-            }
-            else{
-                seed_side = 1;
-            }
+    // Decide what orientation to use for the seed node
+    auto max_edge_info = n_edges_per_node.at(max_node);
+    auto n_reverse = max_edge_info[1];
+    auto n_forward = max_edge_info[0];
 
-            auto& seed_handle = get_side(edge, seed_side);
-            auto& other_handle = get_side(edge, !seed_side);
-            auto other_node = gfa_graph.get_id(other_handle);
+    bool seed_majority_reversal = false;
+    if (n_reverse > n_forward){
+        seed_majority_reversal = true;
+    }
 
-            edge_t flipped_edge;
-            bool secondary_reversal;
+    // Iterate the edges directly linked with the seed node and flip them if necessary
+    // Additionally flip (as necessary) all the secondary edges that stem from the seed node's adjacent nodes
+    for (auto i: primary_edge_indexes.at(max_node)){
+        auto& edge = biclique[i];
+        size_t seed_side;
 
-            if (gfa_graph.get_is_reverse(seed_handle) != seed_majority_reversal){
-                flipped_edge.first = gfa_graph.flip(edge.second);
-                flipped_edge.second = gfa_graph.flip(edge.first);
-                secondary_reversal = gfa_graph.get_is_reverse(get_side(flipped_edge, seed_side));
+        if (get_node_side(edge.first, 0) == max_node){
+            seed_side = 0;
+        }
+        else{
+            seed_side = 1;
+        }
 
-            }
-            else{
-                flipped_edge = edge;
-                secondary_reversal = gfa_graph.get_is_reverse(get_side(flipped_edge, !seed_side));
-            }
+        auto& seed_handle = get_side(edge, seed_side);
+        auto& other_handle = get_side(edge, !seed_side);
+        auto other_node = get_node_side(other_handle, !seed_side);
 
-            // Find whether the secondary node would be reversed by this operation
+        edge_t flipped_edge;
+        bool secondary_reversal;
 
-            for (auto& secondary_edge_index: primary_edge_indexes.at(other_node)) {
-                auto& secondary_edge = biclique[secondary_edge_index];
+        if (gfa_graph.get_is_reverse(seed_handle) != seed_majority_reversal){
+            flipped_edge.first = gfa_graph.flip(edge.second);
+            flipped_edge.second = gfa_graph.flip(edge.first);
+            secondary_reversal = gfa_graph.get_is_reverse(get_side(flipped_edge, seed_side));
 
-                if (secondary_edge == edge) {
-                    // Don't reevaluate the edge that stems from the seed node
-                    continue;
-                }
+        }
+        else{
+            flipped_edge = edge;
+            secondary_reversal = gfa_graph.get_is_reverse(get_side(flipped_edge, !seed_side));
+        }
 
-                bool secondary_seed_side;
-                if (gfa_graph.get_id(secondary_edge.first) == other_node) {
-                    secondary_seed_side = 0;
-                } else {
-                    secondary_seed_side = 1;
-                }
+        // Find whether the secondary node would be reversed by this operation
 
-                auto& secondary_seed_handle = get_side(secondary_edge, secondary_seed_side);
+        for (auto& secondary_edge_index: primary_edge_indexes.at(other_node)) {
+            auto& secondary_edge = biclique[secondary_edge_index];
 
-                if (gfa_graph.get_is_reverse(secondary_seed_handle) != secondary_reversal) {
-                    edge_t secondary_flipped_edge;
-                    secondary_flipped_edge.first = gfa_graph.flip(secondary_edge.second);
-                    secondary_flipped_edge.second = gfa_graph.flip(secondary_edge.first);
+            if (secondary_edge == edge) {
+                // Don't reevaluate the edge that stems from the seed node
+                continue;
+            }
 
-                    biclique[secondary_edge_index] = secondary_flipped_edge;
-                }
+            bool secondary_seed_side;
+            if (get_node_side(secondary_edge.first, 0) == other_node) {
+                secondary_seed_side = 0;
+            } else {
+                secondary_seed_side = 1;
             }
 
-            biclique[i] = flipped_edge;
+            auto& secondary_seed_handle = get_side(secondary_edge, secondary_seed_side);
+
+            if (gfa_graph.get_is_reverse(secondary_seed_handle) != secondary_reversal) {
+                edge_t secondary_flipped_edge;
+                secondary_flipped_edge.first = gfa_graph.flip(secondary_edge.second);
+                secondary_flipped_edge.second = gfa_graph.flip(secondary_edge.first);
+
+                biclique[secondary_edge_index] = secondary_flipped_edge;
+            }
         }
+
+        biclique[i] = flipped_edge;
+    }
+
+    return biclique;
+}
+
+
+void Bluntifier::harmonize_biclique_orientations(){
+    for (auto& biclique: bicliques.bicliques){
+        biclique = get_harmonized_edges(biclique);
     }
 }
 
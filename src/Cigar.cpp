@@ -192,14 +192,14 @@ bool Alignment::step_through_alignment(AlignmentIterator& iterator){
 
 
 vector<Cigar> Alignment::explicitize_mismatches(
-        const string& query_sequence,
         const string& ref_sequence,
+        const string& query_sequence,
         uint64_t ref_start_index,
         uint64_t query_start_index){
 
     // TODO: rewrite this function without copying? Use insert operations instead
 
-    AlignmentIterator iterator(query_start_index, ref_start_index);
+    AlignmentIterator iterator(ref_start_index, query_start_index);
     vector<Cigar> explicit_operations;
 
     while (step_through_alignment(iterator)) {
@@ -230,10 +230,19 @@ vector<Cigar> Alignment::explicitize_mismatches(
         }
         else{
             // Just copy any non-match operations
-            explicit_operations.emplace_back(operations[iterator.cigar_index]);
-
-            // Skip iterating the remaining coordinates in this cigar if its not a Match operation
-            iterator.next_cigar();
+            auto& c = operations[iterator.cigar_index];
+            explicit_operations.emplace_back(c);
+
+            // Skip iterating the remaining coordinates in this cigar if its not a Match operation. The indexes still
+            // have to move past it, and the next step starts the next cigar
+            uint64_t n_remaining = c.length - 1 - iterator.intra_cigar_index;
+            if (is_ref_move[c.code]){
+                iterator.ref_index += n_remaining;
+            }
+            if (is_query_move[c.code]){
+                iterator.query_index += n_remaining;
+            }
+            iterator.intra_cigar_index = c.length - 1;
         }
     }
 
@@ -249,7 +258,7 @@ vector<Cigar> Alignment::explicitize_mismatches(
 
     // TODO: rewrite this function without copying? Use insert operations instead
 
-    AlignmentIterator iterator(query_start_index, ref_start_index);
+    AlignmentIterator iterator(ref_start_index, query_start_index);
     vector<Cigar> explicit_operations;
 
     while (step_through_alignment(iterator)) {
@@ -280,10 +289,19 @@ vector<Cigar> Alignment::explicitize_mismatches(
         }
         else{
             // Just copy any non-match operations
-            explicit_operations.emplace_back(operations[iterator.cigar_index]);
-
-            // Skip iterating the remaining coordinates in this cigar if its not a Match operation
-            iterator.next_cigar();
+            auto& c = operations[iterator.cigar_index];
+            explicit_operations.emplace_back(c);
+
+            // Skip iterating the remaining coordinates in this cigar if its not a Match operation. The indexes still
+            // have to move past it, and the next step starts the next cigar
+            uint64_t n_remaining = c.length - 1 - iterator.intra_cigar_index;
+            if (is_ref_move[c.code]){
+                iterator.ref_index += n_remaining;
+            }
+            if (is_query_move[c.code]){
+                iterator.query_index += n_remaining;
+            }
+            iterator.intra_cigar_index = c.length - 1;
         }
     }
 
@@ -7,28 +7,25 @@ Duplicator::Duplicator(
         const vector <vector <BicliqueEdgeIndex> >& node_to_biclique_edge,
         OverlapMap& overlaps,
         Bicliques& bicliques,
-        map <nid_t, set<nid_t> >& parent_to_children,
-        map <nid_t, pair<nid_t, bool> >& child_to_parent,
-        map<nid_t, OverlappingNodeInfo>& overlapping_overlap_nodes
+        Parentage& parentage,
+        OverlappingOverlapNodes& overlapping_overlap_nodes
         ):
         node_to_biclique_edge(node_to_biclique_edge),
         overlaps(overlaps),
         bicliques(bicliques),
-        parent_to_children(parent_to_children),
-        child_to_parent(child_to_parent),
+        parentage(parentage),
         overlapping_overlap_nodes(overlapping_overlap_nodes)
 {}
 
 
-map<nid_t, OverlappingNodeInfo>::iterator Duplicator::preprocess_overlapping_overlaps(
+OverlappingNodeInfo& Duplicator::preprocess_overlapping_overlaps(
         MutablePathDeletableHandleGraph& gfa_graph,
         array <deque <size_t>, 2>& sorted_sizes_per_side,
         array <deque <size_t>, 2>& sorted_bicliques_per_side,
         array<map<size_t, handle_t>, 2>& biclique_side_to_child,
         const NodeInfo& node_info){
 
-    auto result = overlapping_overlap_nodes.emplace(node_info.node_id, node_info.node_id);
-    auto& overlap_node_info = result.first->second;
+    auto& overlap_node_info = overlapping_overlap_nodes.emplace(node_info.node_id);
 
     auto parent_handle = gfa_graph.get_handle(node_info.node_id, false);
     overlap_node_info.length = gfa_graph.get_length(parent_handle);
@@ -52,8 +49,7 @@ map<nid_t, OverlappingNodeInfo>::iterator Duplicator::preprocess_overlapping_ove
 
             // Update provenance map
             auto child_node = gfa_graph.get_id(child);
-            child_to_parent[child_node] = {node_info.node_id, true};
-            parent_to_children[node_info.node_id].emplace(child_node);
+            parentage.add_child(child_node, node_info.node_id, true);
 
             sorted_sizes_per_side[0].pop_front();
             sorted_bicliques_per_side[0].pop_front();
@@ -74,25 +70,22 @@ map<nid_t, OverlappingNodeInfo>::iterator Duplicator::preprocess_overlapping_ove
 
             // Update provenance map
             auto child_node = gfa_graph.get_id(child);
-            child_to_parent[child_node] = {node_info.node_id, true};
-            parent_to_children[node_info.node_id].emplace(child_node);
+            parentage.add_child(child_node, node_info.node_id, true);
 
             sorted_sizes_per_side[1].pop_front();
             sorted_bicliques_per_side[1].pop_front();
         }
     }
 
-    return result.first;
+    return overlap_node_info;
 }
 
 
 void Duplicator::postprocess_overlapping_overlap(
         const HandleGraph& gfa_graph,
-        map<nid_t, OverlappingNodeInfo>::iterator iter,
+        OverlappingNodeInfo& overlapping_node_info,
         array<map<size_t, handle_t>, 2> biclique_side_to_child){
 
-    auto& overlapping_node_info = iter->second;
-
     // Deduplicate the non-OO biclique info
     array<set<size_t>, 2> oo_biclique_indexes;
     for (auto side: {0,1}) {
@@ -278,8 +271,7 @@ void Duplicator::duplicate_termini(
         for (size_t i = 1; i < left_children.size(); i++) {
             auto child_node = gfa_graph.get_id(left_children[i]);
 
-            child_to_parent[child_node] = {node_info.node_id, child_node != parent_node};
-            parent_to_children[node_info.node_id].emplace(child_node);
+            parentage.add_child(child_node, node_info.node_id, child_node != parent_node);
         }
     }
 
@@ -289,8 +281,7 @@ void Duplicator::duplicate_termini(
         for (size_t i = 1; i < right_children.size(); i++) {
             auto child_node = gfa_graph.get_id(right_children[i]);
 
-            child_to_parent[child_node] = {node_info.node_id, child_node != parent_node};
-            parent_to_children[node_info.node_id].emplace(child_node);
+            parentage.add_child(child_node, node_info.node_id, child_node != parent_node);
         }
     }
 
@@ -342,10 +333,12 @@ void Duplicator::duplicate_all_node_termini(MutablePathDeletableHandleGraph& gfa
 
         set <size_t> overlapping_bicliques;
 
-        auto overlapping_overlap_iter = overlapping_overlap_nodes.end();
+        // Stays valid until the next OO node is added
+        OverlappingNodeInfo* overlapping_node_info = nullptr;
+
         // If this is an overlapping overlap node, the offending overlaps need to be processed separately
         if (contains_overlapping_overlaps(gfa_graph, parent_handle, sorted_sizes_per_side)){
-            overlapping_overlap_iter = preprocess_overlapping_overlaps(
+            overlapping_node_info = &preprocess_overlapping_overlaps(
                     gfa_graph,
                     sorted_sizes_per_side,
                     sorted_bicliques_per_side,
@@ -367,8 +360,8 @@ void Duplicator::duplicate_all_node_termini(MutablePathDeletableHandleGraph& gfa
                 parent_handle_flipped);
 
 
-        if (overlapping_overlap_iter != overlapping_overlap_nodes.end()){
-            postprocess_overlapping_overlap(gfa_graph, overlapping_overlap_iter, biclique_side_to_child);
+        if (overlapping_node_info != nullptr){
+            postprocess_overlapping_overlap(gfa_graph, *overlapping_node_info, biclique_side_to_child);
         }
     }
 }
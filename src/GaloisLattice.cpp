@@ -18,6 +18,11 @@ using std::numeric_limits;
 using std::make_pair;
 using std::cerr;
 using std::endl;
+using std::unique_ptr;
+using std::thread;
+using std::atomic;
+using std::min;
+using std::move;
 
 CenteredGaloisTree::CenteredGaloisTree(const BipartiteGraph& graph,
                                        handle_t center) {
@@ -344,7 +349,54 @@ bipartition CenteredGaloisTree::biclique(size_t i) const {
     return return_val;
 }
 
-GaloisLattice::GaloisLattice(const BipartiteGraph& graph) {
+bool GaloisLattice::build_galois_trees(const BipartiteGraph& graph, size_t num_threads) {
+    
+    galois_trees.reserve(graph.left_size());
+    
+    if (num_threads <= 1) {
+        for (auto it = graph.left_begin(), end = graph.left_end(); it != end; ++it) {
+            galois_trees.emplace_back(graph, *it);
+            if (!galois_trees.back().has_neighbor_ordering_property()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // the trees are independent, so we can build them in any order and then
+    // put them back in the order of the left nodes
+    vector<unique_ptr<CenteredGaloisTree>> trees(graph.left_size());
+    atomic<size_t> next_center(0);
+    atomic<bool> domino_free(true);
+    auto build_trees = [&]() {
+        for (size_t i = next_center.fetch_add(1); i < trees.size() && domino_free.load();
+             i = next_center.fetch_add(1)) {
+            trees[i] = unique_ptr<CenteredGaloisTree>(new CenteredGaloisTree(graph, *(graph.left_begin() + i)));
+            if (!trees[i]->has_neighbor_ordering_property()) {
+                // no need to keep going, the whole graph is not domino free
+                domino_free.store(false);
+            }
+        }
+    };
+    vector<thread> workers;
+    for (size_t t = 1; t < min(num_threads, trees.size()); ++t) {
+        workers.emplace_back(build_trees);
+    }
+    build_trees();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    if (!domino_free.load()) {
+        return false;
+    }
+    for (auto& tree : trees) {
+        galois_trees.emplace_back(move(*tree));
+    }
+    return true;
+}
+
+GaloisLattice::GaloisLattice(const BipartiteGraph& graph, size_t num_threads, size_t min_parallel_size) {
     
     // algorithm 4 in Amilhastre
     
@@ -352,14 +404,10 @@ GaloisLattice::GaloisLattice(const BipartiteGraph& graph) {
     cerr << "making centered trees" << endl;
 #endif
     
-    galois_trees.reserve(graph.left_size());
-    for (auto it = graph.left_begin(), end = graph.left_end(); it != end; ++it) {
-        galois_trees.emplace_back(graph, *it);
-        if (!galois_trees.back().has_neighbor_ordering_property()) {
-            // this graph is not domino free
-            clear();
-            return;
-        }
+    if (!build_galois_trees(graph, graph.left_size() >= min_parallel_size ? num_threads : 1)) {
+        // this graph is not domino free
+        clear();
+        return;
     }
     
 #ifdef debug_galois_lattice
@@ -28,7 +28,7 @@ NodeInfo::NodeInfo(
 
 NodeInfo::NodeInfo(
         const vector<vector<BicliqueEdgeIndex> >& node_to_biclique_edge,
-        const map <nid_t, pair<nid_t, bool> >& child_to_parent,
+        const Parentage& parentage,
         const Bicliques& bicliques,
         const HandleGraph& gfa_graph,
         const OverlapMap& overlaps,
@@ -39,7 +39,7 @@ NodeInfo::NodeInfo(
         overlaps(overlaps),
         node_id(node_id) {
 
-    factor_overlaps_by_biclique_and_side(child_to_parent);
+    factor_overlaps_by_biclique_and_side(parentage);
     sort_factored_overlaps();
 }
 
@@ -91,7 +91,7 @@ size_t NodeInfo::get_overlap_length(edge_t edge, bool side) {
 
 // For one node, make a mapping: (side -> (biclique_index -> (edge_index,length) ) )
 // Overloaded to find overlaps that involve the original parent node if the graph has been edited
-void NodeInfo::factor_overlaps_by_biclique_and_side(const map <nid_t, pair<nid_t, bool> >& child_to_parent) {
+void NodeInfo::factor_overlaps_by_biclique_and_side(const Parentage& parentage) {
 
     for (auto& index: node_to_biclique_edge[node_id]) {
         edge_t edge = bicliques[index];
@@ -99,17 +99,15 @@ void NodeInfo::factor_overlaps_by_biclique_and_side(const map <nid_t, pair<nid_t
 
         // Parent node needs to be found if it exists
         nid_t left_node_id = gfa_graph.get_id(edge.first);
-        auto left_parent_node_iter = child_to_parent.find(left_node_id);
 
-        if (left_parent_node_iter !=  child_to_parent.end()){
-            left_node_id = left_parent_node_iter->second.first;
+        if (parentage.is_child(left_node_id)){
+            left_node_id = parentage.get_parent(left_node_id).first;
         }
 
         nid_t right_node_id = gfa_graph.get_id(edge.second);
-        auto right_parent_node_iter = child_to_parent.find(right_node_id);
 
-        if (right_parent_node_iter !=  child_to_parent.end()){
-            right_node_id = right_parent_node_iter->second.first;
+        if (parentage.is_child(right_node_id)){
+            right_node_id = parentage.get_parent(right_node_id).first;
         }
 
         // If the node is on the "left" of an edge then the overlap happens on the "right side" of the node...
@@ -0,0 +1,1099 @@
+#include "OverlapAligner.hpp"
+#include "unchop.hpp"
+#include "utility.hpp"
+
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <string_view>
+#include <chrono>
+
+using std::unordered_map;
+using std::string_view;
+using std::to_string;
+using std::chrono::steady_clock;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using handlegraph::nid_t;
+using std::runtime_error;
+using std::numeric_limits;
+using std::make_tuple;
+using std::reverse;
+using std::sort;
+using std::unique;
+using std::min;
+using std::max;
+
+
+namespace {
+
+// The wavefronts of a unit cost global alignment. Wavefront s covers the diagonals [-s, s] (ref index - query index)
+// and stores the furthest ref index reached on each of them with s edits
+class WavefrontTable{
+public:
+    const string& ref;
+    const string& query;
+    const int64_t n;
+    const int64_t m;
+    const int64_t final_diagonal;
+    static constexpr int64_t none = numeric_limits<int64_t>::min() / 2;
+
+    vector <vector <int64_t> > wavefronts;
+
+    WavefrontTable(const string& ref, const string& query):
+            ref(ref),
+            query(query),
+            n(ref.size()),
+            m(query.size()),
+            final_diagonal(n - m)
+    {}
+
+    int64_t get_offset(int64_t s, int64_t diagonal) const{
+        if (s < 0 or diagonal < -s or diagonal > s) {
+            return none;
+        }
+        return wavefronts[s][diagonal + s];
+    }
+
+    int64_t extend(int64_t diagonal, int64_t offset) const{
+        int64_t query_index = offset - diagonal;
+        while (offset < n and query_index < m and ref[offset] == query[query_index]) {
+            offset++;
+            query_index++;
+        }
+        return offset;
+    }
+
+    // The offsets reachable on a diagonal from each type of edit in the previous wavefront, or none if out of bounds
+    int64_t mismatch_offset(int64_t s, int64_t diagonal) const{
+        int64_t offset = get_offset(s - 1, diagonal);
+        return (offset != none and offset < n and offset - diagonal < m) ? offset + 1 : none;
+    }
+    int64_t insertion_offset(int64_t s, int64_t diagonal) const{
+        int64_t offset = get_offset(s - 1, diagonal + 1);
+        return (offset != none and offset - diagonal <= m) ? offset : none;
+    }
+    int64_t deletion_offset(int64_t s, int64_t diagonal) const{
+        int64_t offset = get_offset(s - 1, diagonal - 1);
+        return (offset != none and offset < n) ? offset + 1 : none;
+    }
+
+    // Compute wavefronts until the end of both sequences is reached, returning the edit distance, or -1 if it is
+    // greater than max_edits
+    int64_t compute(int64_t max_edits){
+        wavefronts.clear();
+        wavefronts.emplace_back(1, extend(0, 0));
+
+        // Every edit moves at most one diagonal
+        if (max_edits < n - m or max_edits < m - n) {
+            return -1;
+        }
+
+        int64_t s = 0;
+        while (get_offset(s, final_diagonal) != n) {
+            if (s == max_edits) {
+                return -1;
+            }
+
+            s++;
+            wavefronts.emplace_back(2*s + 1, none);
+
+            for (int64_t k = -s; k <= s; k++) {
+                int64_t offset = max({mismatch_offset(s, k), insertion_offset(s, k), deletion_offset(s, k)});
+
+                if (offset != none) {
+                    wavefronts[s][k + s] = extend(k, offset);
+                }
+            }
+        }
+
+        return s;
+    }
+};
+
+
+uint64_t mix_hash(uint64_t x){
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+
+// The smallest sketch_size distinct hashes of the k-mers of the sequence, in ascending order
+vector<uint64_t> sketch_kmers(const string& sequence, size_t k, size_t sketch_size){
+    vector<uint64_t> hashes;
+
+    if (sequence.size() < k) {
+        return hashes;
+    }
+
+    hashes.reserve(sequence.size() - k + 1);
+
+    uint64_t mask = (k < 32) ? (uint64_t(1) << (2*k)) - 1 : numeric_limits<uint64_t>::max();
+    uint64_t kmer = 0;
+
+    for (size_t i = 0; i < sequence.size(); i++) {
+        // Maps A, C, G and T (in either case) to distinct 2 bit codes
+        kmer = ((kmer << 2) | ((uint64_t(sequence[i]) >> 1) & 3)) & mask;
+
+        if (i + 1 >= k) {
+            hashes.emplace_back(mix_hash(kmer));
+        }
+    }
+
+    sort(hashes.begin(), hashes.end());
+    hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+
+    if (hashes.size() > sketch_size) {
+        hashes.resize(sketch_size);
+    }
+
+    return hashes;
+}
+
+
+// Jaccard distance, estimated from the fraction of the bottom sketch of the union that both sketches contain
+double sketch_distance(const vector<uint64_t>& a, const vector<uint64_t>& b, size_t sketch_size){
+    if (a.empty() and b.empty()) {
+        return 0;
+    }
+
+    size_t i = 0;
+    size_t j = 0;
+    size_t n_union = 0;
+    size_t n_shared = 0;
+
+    while (n_union < sketch_size and (i < a.size() or j < b.size())) {
+        if (j == b.size() or (i < a.size() and a[i] < b[j])) {
+            i++;
+        }
+        else if (i == a.size() or b[j] < a[i]) {
+            j++;
+        }
+        else {
+            i++;
+            j++;
+            n_shared++;
+        }
+        n_union++;
+    }
+
+    return 1.0 - double(n_shared)/double(n_union);
+}
+
+}
+
+
+namespace bluntifier {
+
+
+BackboneGraph::BackboneGraph(const string& backbone_sequence, HashGraph& graph):
+        backbone_sequence(backbone_sequence),
+        graph(graph)
+{
+    backbone.reserve(backbone_sequence.size());
+
+    for (auto c: backbone_sequence) {
+        backbone.emplace_back(graph.create_handle(string(1, c)));
+
+        if (backbone.size() > 1) {
+            graph.create_edge(backbone[backbone.size() - 2], backbone.back());
+        }
+    }
+}
+
+
+void BackboneGraph::add_backbone_path(const path_handle_t& path) {
+    for (auto& h: backbone) {
+        graph.append_step(path, h);
+    }
+}
+
+
+void BackboneGraph::add_path(
+        const path_handle_t& path,
+        const string& sequence,
+        const vector<Cigar>& operations,
+        size_t backbone_start) {
+
+    size_t backbone_index = backbone_start;
+    size_t index = 0;
+    size_t insert_offset = 0;
+
+    vector <handle_t> steps;
+    steps.reserve(sequence.size());
+
+    for (auto& c: operations) {
+        char type = c.type();
+
+        for (size_t k = 0; k < c.length; k++) {
+            bool is_match = (type == 'M' or type == '=' or type == 'X');
+
+            if (is_match or type == 'I') {
+                char base = sequence[index];
+                insert_offset = is_match ? 0 : insert_offset + 1;
+
+                if (is_match and base == backbone_sequence[backbone_index]) {
+                    steps.emplace_back(backbone[backbone_index]);
+                }
+                else {
+                    auto key = make_tuple(backbone_index, insert_offset, base);
+                    auto result = variant_nodes.find(key);
+
+                    if (result == variant_nodes.end()) {
+                        result = variant_nodes.emplace(key, graph.create_handle(string(1, base))).first;
+                    }
+
+                    steps.emplace_back(result->second);
+                }
+
+                index++;
+                backbone_index += is_match;
+            }
+            else if (type == 'D') {
+                // Base only in the backbone
+                insert_offset = 0;
+                backbone_index++;
+            }
+            else {
+                throw runtime_error("ERROR: unsupported cigar operation for backbone alignment: " + string(1, type));
+            }
+        }
+    }
+
+    for (size_t k = 0; k < steps.size(); k++) {
+        if (k > 0) {
+            graph.create_edge(steps[k - 1], steps[k]);
+        }
+        graph.append_step(path, steps[k]);
+    }
+}
+
+
+pair<size_t, size_t> OverlapAligner::find_shared_flanks(const vector<string>& sequences){
+    size_t min_length = numeric_limits<size_t>::max();
+
+    for (auto& sequence: sequences) {
+        min_length = min(min_length, sequence.size());
+    }
+
+    if (sequences.empty() or min_length == 0) {
+        return {0, 0};
+    }
+
+    // Every sequence must keep at least one base for alignment, so that it still has a path through the result
+    size_t max_flank_length = min_length - 1;
+    auto& reference = sequences[0];
+
+    size_t prefix_length = 0;
+    while (prefix_length < max_flank_length) {
+        bool shared = true;
+        for (auto& sequence: sequences) {
+            if (sequence[prefix_length] != reference[prefix_length]) {
+                shared = false;
+                break;
+            }
+        }
+        if (not shared) {
+            break;
+        }
+        prefix_length++;
+    }
+
+    size_t suffix_length = 0;
+    while (prefix_length + suffix_length < max_flank_length) {
+        bool shared = true;
+        for (auto& sequence: sequences) {
+            if (sequence[sequence.size() - 1 - suffix_length] != reference[reference.size() - 1 - suffix_length]) {
+                shared = false;
+                break;
+            }
+        }
+        if (not shared) {
+            break;
+        }
+        suffix_length++;
+    }
+
+    return {prefix_length, suffix_length};
+}
+
+
+void OverlapAligner::align(const vector<string>& sequences, Subgraph& subgraph){
+    auto& graph = subgraph.graph;
+
+    size_t prefix_length;
+    size_t suffix_length;
+    std::tie(prefix_length, suffix_length) = find_shared_flanks(sequences);
+
+    if (prefix_length == 0 and suffix_length == 0) {
+        align_divergent(sequences, subgraph);
+        unchop(&graph);
+        return;
+    }
+
+    // The flanks are shared by every path, so they each get a single node
+    handle_t prefix_handle;
+    handle_t suffix_handle;
+
+    if (prefix_length > 0) {
+        prefix_handle = graph.create_handle(sequences[0].substr(0, prefix_length));
+    }
+    if (suffix_length > 0) {
+        suffix_handle = graph.create_handle(sequences[0].substr(sequences[0].size() - suffix_length));
+    }
+
+    vector <string> cores;
+    cores.reserve(sequences.size());
+    for (auto& sequence: sequences) {
+        cores.emplace_back(sequence.substr(prefix_length, sequence.size() - prefix_length - suffix_length));
+    }
+
+    subgraph.for_each_path([&](const PathInfo& path_info) {
+        if (prefix_length > 0) {
+            graph.append_step(path_info.path_handle, prefix_handle);
+        }
+    });
+
+    align_divergent(cores, subgraph);
+
+    // Link the aligned middle of each path to the flanks
+    subgraph.for_each_path([&](const PathInfo& path_info) {
+        auto& path_handle = path_info.path_handle;
+
+        if (prefix_length > 0) {
+            auto first_core_step = graph.get_next_step(graph.path_begin(path_handle));
+            graph.create_edge(prefix_handle, graph.get_handle_of_step(first_core_step));
+        }
+        if (suffix_length > 0) {
+            graph.create_edge(graph.get_handle_of_step(graph.path_back(path_handle)), suffix_handle);
+            graph.append_step(path_handle, suffix_handle);
+        }
+    });
+
+    unchop(&graph);
+}
+
+
+void OverlapAligner::delegate_divergent(OverlapAligner& aligner, const vector<string>& sequences, Subgraph& subgraph){
+    aligner.align_divergent(sequences, subgraph);
+}
+
+
+vector<size_t> SpoaAligner::get_guide_order(
+        const vector<string>& sequences,
+        const vector<size_t>& distinct_indexes,
+        const vector<uint32_t>& weights){
+
+    size_t n = distinct_indexes.size();
+
+    vector<size_t> order;
+    order.reserve(n);
+
+    // With two sequences the only choice is which one seeds the graph, so keep the original order
+    if (n < 3) {
+        for (size_t d = 0; d < n; d++) {
+            order.emplace_back(d);
+        }
+        return order;
+    }
+
+    vector <vector <uint64_t> > sketches;
+    sketches.reserve(n);
+    for (auto index: distinct_indexes) {
+        sketches.emplace_back(sketch_kmers(sequences[index], guide_kmer_length, guide_sketch_size));
+    }
+
+    vector<double> distances(n*n, 0);
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = a + 1; b < n; b++) {
+            distances[a*n + b] = sketch_distance(sketches[a], sketches[b], guide_sketch_size);
+            distances[b*n + a] = distances[a*n + b];
+        }
+    }
+
+    // Seed the graph with the sequence that is closest to all the others
+    size_t next = 0;
+    double min_total = numeric_limits<double>::max();
+    for (size_t a = 0; a < n; a++) {
+        double total = 0;
+        for (size_t b = 0; b < n; b++) {
+            total += double(weights[b])*distances[a*n + b];
+        }
+        if (total < min_total) {
+            min_total = total;
+            next = a;
+        }
+    }
+
+    vector<double> distance_to_order(n, numeric_limits<double>::max());
+    vector<bool> is_ordered(n, false);
+
+    while (order.size() < n) {
+        order.emplace_back(next);
+        is_ordered[next] = true;
+
+        size_t previous = next;
+        double min_distance = numeric_limits<double>::max();
+
+        for (size_t d = 0; d < n; d++) {
+            if (is_ordered[d]) {
+                continue;
+            }
+
+            distance_to_order[d] = min(distance_to_order[d], distances[previous*n + d]);
+
+            if (distance_to_order[d] < min_distance) {
+                min_distance = distance_to_order[d];
+                next = d;
+            }
+        }
+    }
+
+    return order;
+}
+
+
+void SpoaAligner::add_alignments_to_poa(
+        Graph& spoa_graph,
+        unique_ptr<AlignmentEngine>& alignment_engine,
+        const vector<string>& sequences,
+        const vector<size_t>& distinct_indexes,
+        const vector<uint32_t>& weights){
+
+    for (size_t d = 0; d < distinct_indexes.size(); d++){
+        auto& sequence = sequences[distinct_indexes[d]];
+
+        auto alignment = alignment_engine->Align(sequence, spoa_graph);
+        spoa_graph.AddAlignment(alignment, sequence, weights[d]);
+    }
+}
+
+
+void SpoaAligner::add_alignments_to_frozen_poa(
+        Graph& spoa_graph,
+        const vector<string>& sequences,
+        const vector<size_t>& distinct_indexes,
+        const vector<uint32_t>& weights) const{
+
+    vector <spoa::Alignment> alignments(distinct_indexes.size());
+
+    atomic <size_t> next_index(0);
+    auto align_sequences = [&]() {
+        // Alignment engines hold their DP matrices, so each thread needs its own
+        auto alignment_engine = AlignmentEngine::Create(AlignmentType::kSW, 5, -3, -3, -1);
+
+        for (size_t d = next_index.fetch_add(1); d < distinct_indexes.size(); d = next_index.fetch_add(1)) {
+            alignments[d] = alignment_engine->Align(sequences[distinct_indexes[d]], spoa_graph);
+        }
+    };
+
+    // Serial if this biclique is itself being aligned in parallel with others
+    run_in_parallel(min(n_threads, distinct_indexes.size()), align_sequences);
+
+    for (size_t d = 0; d < distinct_indexes.size(); d++){
+        spoa_graph.AddAlignment(alignments[d], sequences[distinct_indexes[d]], weights[d]);
+    }
+}
+
+
+void SpoaAligner::convert_spoa_to_bdsg(
+        Graph& spoa_graph,
+        uint32_t first_spoa_id,
+        const vector<string>& sequences,
+        const vector<size_t>& representatives,
+        Subgraph& subgraph){
+
+    auto& paths = spoa_graph.sequences();
+    auto n_nodes = spoa_graph.nodes().size();
+
+    // Any one of the sequences that each distinct sequence represents
+    size_t n_distinct = 0;
+    for (auto r: representatives){
+        n_distinct = max(n_distinct, r + 1);
+    }
+
+    vector <size_t> distinct_sequences(n_distinct);
+    for (size_t s = 0; s < sequences.size(); s++){
+        distinct_sequences[representatives[s]] = s;
+    }
+
+    // The unique neighbor of each SPOA node along the paths, if it has exactly one
+    static constexpr uint32_t none = numeric_limits<uint32_t>::max();
+    static constexpr uint32_t multiple = none - 1;
+
+    vector <uint32_t> successors(n_nodes, none);
+    vector <uint32_t> predecessors(n_nodes, none);
+    vector <bool> is_path_start(n_nodes, false);
+    vector <bool> is_path_end(n_nodes, false);
+    vector <char> bases(n_nodes);
+
+    auto link = [&](uint32_t& neighbor, uint32_t id){
+        if (neighbor == none){
+            neighbor = id;
+        }
+        else if (neighbor != id){
+            neighbor = multiple;
+        }
+    };
+
+    vector <vector <uint32_t> > node_paths(n_distinct);
+
+    for (size_t d = 0; d < n_distinct; d++){
+        auto& sequence = sequences[distinct_sequences[d]];
+        uint32_t spoa_id = first_spoa_id + d;
+        auto& node_path = node_paths[d];
+        node_path.reserve(sequence.size());
+
+        // This points to the first SPOA node within the path that this sequence aligned to in the SPOA graph
+        for (auto node = paths[spoa_id]; node != nullptr; node = node->Successor(spoa_id)){
+            bases[node->id] = sequence[node_path.size()];
+
+            if (not node_path.empty()){
+                link(successors[node_path.back()], node->id);
+                link(predecessors[node->id], node_path.back());
+            }
+
+            node_path.emplace_back(node->id);
+        }
+
+        is_path_start[node_path.front()] = true;
+        is_path_end[node_path.back()] = true;
+    }
+
+    // The same condition that unchop uses: a single edge between the nodes, and every path that visits one of them
+    // continues through the other
+    auto joins_successor = [&](uint32_t id){
+        auto next = successors[id];
+        return next < multiple and predecessors[next] == id and not is_path_end[id] and not is_path_start[next];
+    };
+
+    // Each run of nodes is emitted as a node when its first SPOA node is reached
+    unordered_map <uint32_t, handle_t> nodes_created;
+    vector <vector <handle_t> > handle_paths(n_distinct);
+
+    for (size_t d = 0; d < n_distinct; d++){
+        auto& node_path = node_paths[d];
+
+        for (size_t k = 0; k < node_path.size(); k++){
+            if (k > 0 and joins_successor(node_path[k - 1])){
+                continue;
+            }
+
+            auto iter = nodes_created.find(node_path[k]);
+
+            if (iter == nodes_created.end()){
+                string run;
+                auto id = node_path[k];
+                run += bases[id];
+
+                while (joins_successor(id)){
+                    id = successors[id];
+                    run += bases[id];
+                }
+
+                iter = nodes_created.emplace(node_path[k], subgraph.graph.create_handle(run)).first;
+            }
+
+            if (not handle_paths[d].empty()){
+                subgraph.graph.create_edge(handle_paths[d].back(), iter->second);
+            }
+
+            handle_paths[d].emplace_back(iter->second);
+        }
+    }
+
+    subgraph.for_each_path([&](const PathInfo& path_info){
+        for (auto& h: handle_paths[representatives[path_info.spoa_id]]){
+            subgraph.graph.append_step(path_info.path_handle, h);
+        }
+    });
+}
+
+
+SpoaAligner::SpoaAligner(
+        bool adaptive,
+        double max_single_pass_divergence,
+        size_t n_threads,
+        size_t min_frozen_sequences):
+        adaptive(adaptive),
+        max_single_pass_divergence(max_single_pass_divergence),
+        n_threads(n_threads),
+        min_frozen_sequences(min_frozen_sequences)
+{}
+
+
+string SpoaAligner::describe() const{
+    string description = "spoa kSW 5,-3,-3,-1 seeded 6,-2,-4,-1 weighted guided v4 frozen "
+                         + to_string(min_frozen_sequences);
+
+    if (adaptive){
+        description += " adaptive " + to_string(max_single_pass_divergence);
+    }
+
+    return description;
+}
+
+
+bool SpoaAligner::consensus_is_sufficient(
+        const string& consensus,
+        const vector<string>& sequences,
+        const vector<size_t>& distinct_indexes) const{
+
+    for (auto d: distinct_indexes){
+        auto& sequence = sequences[d];
+        auto max_edits = int64_t(max_single_pass_divergence*double(sequence.size()));
+
+        if (WavefrontAligner::edit_distance(consensus, sequence, max_edits) < 0){
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+uint64_t SpoaAligner::get_n_single_pass() const{
+    return n_single_pass;
+}
+
+
+uint64_t SpoaAligner::get_n_two_pass() const{
+    return n_two_pass;
+}
+
+
+double SpoaAligner::get_seconds_saved() const{
+    return double(nanoseconds_saved)/1e9;
+}
+
+
+uint64_t SpoaAligner::get_n_poa_nodes() const{
+    return n_poa_nodes;
+}
+
+
+uint64_t SpoaAligner::get_n_frozen() const{
+    return n_frozen;
+}
+
+
+void SpoaAligner::align_divergent(const vector<string>& sequences, Subgraph& subgraph){
+    // Handles on the same side often have identical sequences (e.g. sibling haplotypes), so only align each one once
+    unordered_map <string_view, size_t> distinct_sequences;
+    vector <size_t> distinct_indexes;
+    vector <uint32_t> weights;
+    vector <size_t> representatives;
+    representatives.reserve(sequences.size());
+
+    for (size_t s = 0; s < sequences.size(); s++){
+        auto result = distinct_sequences.emplace(sequences[s], distinct_indexes.size());
+
+        if (result.second){
+            distinct_indexes.emplace_back(s);
+            weights.emplace_back(0);
+        }
+
+        representatives.emplace_back(result.first->second);
+        weights[result.first->second]++;
+    }
+
+    // Renumber the distinct sequences so that they are added to the POA in guide order
+    auto guide_order = get_guide_order(sequences, distinct_indexes, weights);
+
+    vector <size_t> ranks(guide_order.size());
+    vector <size_t> ordered_indexes;
+    vector <uint32_t> ordered_weights;
+    ordered_indexes.reserve(guide_order.size());
+    ordered_weights.reserve(guide_order.size());
+
+    for (size_t r = 0; r < guide_order.size(); r++){
+        ranks[guide_order[r]] = r;
+        ordered_indexes.emplace_back(distinct_indexes[guide_order[r]]);
+        ordered_weights.emplace_back(weights[guide_order[r]]);
+    }
+
+    for (auto& representative: representatives){
+        representative = ranks[representative];
+    }
+
+    distinct_indexes = std::move(ordered_indexes);
+    weights = std::move(ordered_weights);
+
+    auto start_time = steady_clock::now();
+
+    auto alignment_engine = AlignmentEngine::Create(AlignmentType::kSW, 5, -3, -3, -1);
+
+    Graph spoa_graph{};
+
+    add_alignments_to_poa(spoa_graph, alignment_engine, sequences, distinct_indexes, weights);
+
+    auto consensus = spoa_graph.GenerateConsensus();
+
+    // If every sequence is already close to the consensus, seeding a second pass with it is unlikely to change the
+    // alignment, so use the first pass as is. The second pass would have cost about as much as the first.
+    if (adaptive and consensus_is_sufficient(consensus, sequences, distinct_indexes)){
+        auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start_time);
+
+        n_single_pass++;
+        nanoseconds_saved += elapsed.count();
+        n_poa_nodes += spoa_graph.nodes().size();
+
+        convert_spoa_to_bdsg(spoa_graph, 0, sequences, representatives, subgraph);
+        return;
+    }
+
+    n_two_pass++;
+
+    Graph seeded_spoa_graph{};
+
+    auto seeded_alignment_engine = AlignmentEngine::Create(AlignmentType::kSW, 6, -2, -4, -1);
+
+    auto alignment = seeded_alignment_engine->Align(consensus, seeded_spoa_graph);
+    seeded_spoa_graph.AddAlignment(alignment, consensus);
+
+    // Iterate a second time on alignment, this time with consensus as the seed
+    uint32_t first_spoa_id = seeded_spoa_graph.sequences().size();
+
+    // Large bicliques are aligned to the seeded graph alone, so that their DP can be split across threads
+    if (distinct_indexes.size() >= min_frozen_sequences){
+        n_frozen++;
+        add_alignments_to_frozen_poa(seeded_spoa_graph, sequences, distinct_indexes, weights);
+    }
+    else {
+        add_alignments_to_poa(seeded_spoa_graph, alignment_engine, sequences, distinct_indexes, weights);
+    }
+    n_poa_nodes += seeded_spoa_graph.nodes().size();
+
+    convert_spoa_to_bdsg(seeded_spoa_graph, first_spoa_id, sequences, representatives, subgraph);
+}
+
+
+WavefrontAligner::WavefrontAligner():
+        own_fallback_aligner(new SpoaAligner()),
+        fallback_aligner(*own_fallback_aligner),
+        max_edit_fraction(default_max_edit_fraction),
+        max_edits(default_max_edits)
+{}
+
+
+WavefrontAligner::WavefrontAligner(OverlapAligner& fallback_aligner, double max_edit_fraction, int64_t max_edits):
+        fallback_aligner(fallback_aligner),
+        max_edit_fraction(max_edit_fraction),
+        max_edits(max_edits)
+{}
+
+
+bool WavefrontAligner::align_pair(
+        const string& ref,
+        const string& query,
+        int64_t max_edits,
+        vector<Cigar>& operations){
+
+    operations.clear();
+
+    WavefrontTable table(ref, query);
+
+    int64_t s = table.compute(max_edits);
+    if (s < 0) {
+        return false;
+    }
+
+    int64_t n = ref.size();
+
+    // Trace back from the end of both sequences, recovering each edit and the run of matches that followed it
+    vector <char> types;
+    int64_t k = table.final_diagonal;
+    int64_t offset = n;
+
+    for (; s > 0; s--) {
+        int64_t mismatch = table.mismatch_offset(s, k);
+        int64_t insertion = table.insertion_offset(s, k);
+        int64_t deletion = table.deletion_offset(s, k);
+        int64_t start = max({mismatch, insertion, deletion});
+
+        types.insert(types.end(), offset - start, '=');
+
+        if (start == mismatch) {
+            types.emplace_back('X');
+            offset = start - 1;
+        }
+        else if (start == insertion) {
+            types.emplace_back('I');
+            k++;
+            offset = start;
+        }
+        else {
+            types.emplace_back('D');
+            k--;
+            offset = start - 1;
+        }
+    }
+
+    types.insert(types.end(), offset, '=');
+
+    reverse(types.begin(), types.end());
+
+    for (auto type: types) {
+        if (not operations.empty() and operations.back().type() == type) {
+            operations.back().length++;
+        }
+        else {
+            operations.emplace_back(1, type);
+        }
+    }
+
+    return true;
+}
+
+
+int64_t WavefrontAligner::edit_distance(const string& ref, const string& query, int64_t max_edits){
+    WavefrontTable table(ref, query);
+    return table.compute(max_edits);
+}
+
+
+string WavefrontAligner::describe() const{
+    return "wfa edit backbone v3 max " + to_string(max_edit_fraction) + "+" + to_string(min_max_edits) + " <="
+           + to_string(max_edits) + " (" + fallback_aligner.describe() + ")";
+}
+
+
+uint64_t WavefrontAligner::get_n_fallbacks() const{
+    return n_fallbacks;
+}
+
+
+void WavefrontAligner::align_divergent(const vector<string>& sequences, Subgraph& subgraph){
+    auto& backbone_sequence = sequences[0];
+
+    // Every pair is aligned before the graph is touched, so that the fallback aligner can start from scratch
+    vector <vector <Cigar> > operations(sequences.size());
+
+    for (size_t s = 1; s < sequences.size(); s++){
+        auto length = max(backbone_sequence.size(), sequences[s].size());
+        auto max_pair_edits = min(max_edits, int64_t(max_edit_fraction*double(length)) + min_max_edits);
+
+        if (not align_pair(backbone_sequence, sequences[s], max_pair_edits, operations[s])){
+            n_fallbacks++;
+            delegate_divergent(fallback_aligner, sequences, subgraph);
+            return;
+        }
+    }
+
+    BackboneGraph backbone_graph(backbone_sequence, subgraph.graph);
+
+    // Add the paths in the order of their sequences, so that the node IDs only depend on the sequences and not on the
+    // handles that the paths belong to
+    auto paths = subgraph.get_paths_by_sequence(sequences.size());
+
+    backbone_graph.add_backbone_path(paths[0]);
+
+    for (size_t s = 1; s < sequences.size(); s++){
+        backbone_graph.add_path(paths[s], sequences[s], operations[s], 0);
+    }
+}
+
+
+WindowedAligner::WindowedAligner(OverlapAligner& window_aligner, size_t n_threads):
+        window_aligner(window_aligner),
+        n_threads(n_threads)
+{}
+
+
+string WindowedAligner::describe() const{
+    return "windowed k" + to_string(anchor_length) + " w" + to_string(window_length) + " v1 ("
+           + window_aligner.describe() + ")";
+}
+
+
+uint64_t WindowedAligner::get_n_windowed() const{
+    return n_windowed;
+}
+
+
+uint64_t WindowedAligner::get_n_windows() const{
+    return n_windows;
+}
+
+
+vector <vector <size_t> > WindowedAligner::find_anchors(const vector<string>& sequences){
+    vector <vector <size_t> > anchors;
+
+    for (auto& sequence: sequences) {
+        if (sequence.size() < anchor_length) {
+            return anchors;
+        }
+    }
+
+    // Candidate k-mers, keyed by their sequence, with their position in each sequence (-2 if not found yet, -1 if
+    // repeated). Only k-mers that are unique in the first sequence can be anchors
+    unordered_map <string_view, vector <int64_t> > candidates;
+    string_view first(sequences[0]);
+
+    for (size_t p = 0; p + anchor_length <= first.size(); p++) {
+        auto result = candidates.emplace(first.substr(p, anchor_length), vector<int64_t>(sequences.size(), -2));
+        auto& positions = result.first->second;
+        positions[0] = result.second ? int64_t(p) : -1;
+    }
+
+    for (size_t s = 1; s < sequences.size(); s++) {
+        string_view sequence(sequences[s]);
+
+        for (size_t p = 0; p + anchor_length <= sequence.size(); p++) {
+            auto iter = candidates.find(sequence.substr(p, anchor_length));
+
+            if (iter == candidates.end() or iter->second[0] < 0) {
+                continue;
+            }
+
+            auto& position = iter->second[s];
+            position = (position == -2) ? int64_t(p) : -1;
+        }
+    }
+
+    // Chain the candidates in the order of the first sequence, taking each one that is downstream of the previous
+    // anchor in every sequence and far enough from it to make a full window
+    vector <size_t> starts;
+    for (auto& item: candidates) {
+        if (item.second[0] >= 0) {
+            starts.emplace_back(item.second[0]);
+        }
+    }
+    sort(starts.begin(), starts.end());
+
+    vector <size_t> window_starts(sequences.size(), 0);
+
+    for (auto start: starts) {
+        auto& positions = candidates.at(first.substr(start, anchor_length));
+
+        bool is_anchor = true;
+        for (size_t s = 0; s < sequences.size(); s++) {
+            if (positions[s] < 0 or size_t(positions[s]) < window_starts[s] + (s == 0 ? window_length : 0)) {
+                is_anchor = false;
+                break;
+            }
+        }
+
+        if (not is_anchor) {
+            continue;
+        }
+
+        anchors.emplace_back(sequences.size());
+        for (size_t s = 0; s < sequences.size(); s++) {
+            anchors.back()[s] = positions[s];
+            window_starts[s] = positions[s] + anchor_length;
+        }
+    }
+
+    return anchors;
+}
+
+
+void WindowedAligner::align_divergent(const vector<string>& sequences, Subgraph& subgraph){
+    auto& graph = subgraph.graph;
+    auto anchors = find_anchors(sequences);
+
+    // Window w is the part of each sequence between anchor w-1 and anchor w, which may be empty in some sequences
+    size_t n = anchors.size() + 1;
+    vector <vector <string> > window_sequences(n);
+    vector <vector <size_t> > window_members(n);
+    vector <Subgraph> window_subgraphs(n);
+
+    for (size_t w = 0; w < n; w++) {
+        for (size_t s = 0; s < sequences.size(); s++) {
+            size_t start = (w == 0) ? 0 : anchors[w - 1][s] + anchor_length;
+            size_t stop = (w == anchors.size()) ? sequences[s].size() : anchors[w][s];
+
+            if (stop == start) {
+                continue;
+            }
+
+            window_sequences[w].emplace_back(sequences[s].substr(start, stop - start));
+            window_members[w].emplace_back(s);
+        }
+
+        window_subgraphs[w].create_sequence_paths(window_sequences[w].size());
+    }
+
+    atomic <size_t> next_window(0);
+    auto align_windows = [&]() {
+        for (size_t w = next_window.fetch_add(1); w < n; w = next_window.fetch_add(1)) {
+            if (not window_sequences[w].empty()) {
+                window_aligner.align(window_sequences[w], window_subgraphs[w]);
+            }
+        }
+    };
+
+    // The window aligner's own threads run serially within these
+    run_in_parallel(min(n_threads, n), align_windows);
+
+    n_windowed++;
+    n_windows += n;
+
+    // Find the path for each sequence in the combined subgraph
+    auto paths = subgraph.get_paths_by_sequence(sequences.size());
+
+    // The last handle that each path has stepped on so far in this call, if any
+    vector <handle_t> previous(sequences.size());
+    vector <bool> has_previous(sequences.size(), false);
+
+    auto append = [&](size_t s, const handle_t& h) {
+        if (has_previous[s]) {
+            graph.create_edge(previous[s], h);
+        }
+        graph.append_step(paths[s], h);
+        previous[s] = h;
+        has_previous[s] = true;
+    };
+
+    for (size_t w = 0; w < n; w++) {
+        auto& window_graph = window_subgraphs[w].graph;
+        unordered_map <nid_t, handle_t> copies;
+
+        for (size_t m = 0; m < window_members[w].size(); m++) {
+            size_t s = window_members[w][m];
+            auto& path_info = window_subgraphs[w].sequence_paths[m];
+
+            for (auto h: window_graph.scan_path(path_info.path_handle)) {
+                auto id = window_graph.get_id(h);
+                auto iter = copies.find(id);
+
+                if (iter == copies.end()) {
+                    auto forward = window_graph.forward(h);
+                    iter = copies.emplace(id, graph.create_handle(window_graph.get_sequence(forward))).first;
+                }
+
+                append(s, window_graph.get_is_reverse(h) ? graph.flip(iter->second) : iter->second);
+            }
+        }
+
+        if (w < anchors.size()) {
+            auto anchor_handle = graph.create_handle(sequences[0].substr(anchors[w][0], anchor_length));
+
+            for (size_t s = 0; s < sequences.size(); s++) {
+                append(s, anchor_handle);
+            }
+        }
+    }
+}
+
+
+unique_ptr<OverlapAligner> make_overlap_aligner(const string& name){
+    if (name == "spoa") {
+        return unique_ptr<OverlapAligner>(new SpoaAligner());
+    }
+    else if (name == "wfa") {
+        return unique_ptr<OverlapAligner>(new WavefrontAligner());
+    }
+    else {
+        throw runtime_error("ERROR: unrecognized overlap aligner: " + name);
+    }
+}
+
+
+}
@@ -1,6 +1,9 @@
 #include "OverlappingOverlap.hpp"
 
 using std::cerr;
+using std::tie;
+using std::runtime_error;
+using std::to_string;
 
 namespace bluntifier{
 
@@ -49,5 +52,160 @@ void OverlappingNodeInfo::print(HandleGraph& graph){
 }
 
 
+OverlappingNodeInfo& OverlappingOverlapNodes::emplace(nid_t parent_node){
+    if (not nodes.empty() and parent_node <= nodes.back().parent_node){
+        throw runtime_error("ERROR: overlapping overlap nodes must be added in ascending ID order: "
+                            + to_string(parent_node));
+    }
+
+    if (size_t(parent_node) >= node_indexes.size()){
+        node_indexes.resize(parent_node + 1, -1);
+    }
+
+    node_indexes[parent_node] = int64_t(nodes.size());
+    nodes.emplace_back(parent_node);
+
+    return nodes.back();
+}
+
+
+const OverlappingNodeInfo* OverlappingOverlapNodes::find(nid_t parent_node) const{
+    if (size_t(parent_node) >= node_indexes.size() or node_indexes[parent_node] < 0){
+        return nullptr;
+    }
+
+    return &nodes[node_indexes[parent_node]];
+}
+
+
+size_t OverlappingOverlapNodes::size() const{
+    return nodes.size();
+}
+
+
+bool OverlappingOverlapNodes::empty() const{
+    return nodes.empty();
+}
+
+
+vector<OverlappingNodeInfo>::iterator OverlappingOverlapNodes::begin(){
+    return nodes.begin();
+}
+
+
+vector<OverlappingNodeInfo>::iterator OverlappingOverlapNodes::end(){
+    return nodes.end();
+}
+
+
+vector<OverlappingNodeInfo>::const_iterator OverlappingOverlapNodes::begin() const{
+    return nodes.begin();
+}
+
+
+vector<OverlappingNodeInfo>::const_iterator OverlappingOverlapNodes::end() const{
+    return nodes.end();
+}
+
+
+
+OverlappingOverlapIndex::OverlappingOverlapIndex(
+        const PathHandleGraph& graph,
+        const Parentage& parentage,
+        const OverlappingOverlapNodes& overlapping_overlap_nodes){
+
+    auto mark = [&](vector<bool>& flags, nid_t node_id){
+        if (size_t(node_id) >= flags.size()){
+            flags.resize(node_id + 1, false);
+        }
+        flags[node_id] = true;
+    };
+
+    // Only nodes whose own parent is this OO node count, which is what find_roles checks from the other direction
+    auto is_child_of = [&](nid_t node_id, nid_t parent_node, bool is_terminus){
+        return parentage.is_child(node_id)
+               and parentage.get_parent(node_id) == pair<nid_t, bool>(parent_node, is_terminus);
+    };
+
+    for (auto& overlap_info: overlapping_overlap_nodes){
+        auto parent_node = overlap_info.parent_node;
+
+        if (graph.has_path(overlap_info.parent_path_name)) {
+            auto parent_path = graph.get_path_handle(overlap_info.parent_path_name);
+
+            for (auto h: graph.scan_path(parent_path)) {
+                if (is_child_of(graph.get_id(h), parent_node, false)) {
+                    mark(is_parent_material, graph.get_id(h));
+                }
+            }
+        }
+
+        for (auto s: {0, 1}) {
+            for (auto& oo_item: overlap_info.overlapping_children[s]) {
+                auto node_id = graph.get_id(oo_item.second.handle);
+
+                if (is_child_of(node_id, parent_node, true)) {
+                    mark(is_overlapping_child, node_id);
+                }
+            }
+        }
+    }
+}
+
+
+tuple <bool, bool> OverlappingOverlapIndex::get_roles(nid_t node_id) const{
+    bool is_oo_parent = size_t(node_id) < is_parent_material.size() and is_parent_material[node_id];
+    bool is_oo_child = size_t(node_id) < is_overlapping_child.size() and is_overlapping_child[node_id];
+
+    return {is_oo_parent, is_oo_child};
+}
+
+
+tuple <bool, bool> OverlappingOverlapIndex::find_roles(
+        const PathHandleGraph& graph,
+        const Parentage& parentage,
+        const OverlappingOverlapNodes& overlapping_overlap_nodes,
+        nid_t node_id){
+
+    bool is_oo_child = false;
+    bool is_oo_parent = false;
+
+    // Check if this is an Overlapping Overlap node
+    if (parentage.is_child(node_id)){
+        nid_t original_gfa_node;
+        bool is_terminus;
+        tie(original_gfa_node, is_terminus) = parentage.get_parent(node_id);
+
+        auto result = overlapping_overlap_nodes.find(original_gfa_node);
+        if (result != nullptr) {
+            auto& overlap_info = *result;
+
+            // Check if this node is part of the non-terminal parent material in this OO node
+            if (not is_terminus) {
+                auto parent_path = graph.get_path_handle(overlap_info.parent_path_name);
+
+                for (auto h: graph.scan_path(parent_path)) {
+                    if (graph.get_id(h) == node_id) {
+                        is_oo_parent = true;
+                    }
+                }
+            }
+            else {
+                // Brute force search of overlapping children in this OO node to see if this is one of the overlaps
+                // that was excluded from splicing
+                for (auto s: {0, 1}) {
+                    for (auto& oo_item: overlap_info.overlapping_children[s]) {
+                        if (graph.get_id(oo_item.second.handle) == node_id) {
+                            is_oo_child = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return {is_oo_parent, is_oo_child};
+}
+
 
 }
\ No newline at end of file
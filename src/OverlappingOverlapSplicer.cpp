@@ -1,7 +1,11 @@
 #include "OverlappingOverlapSplicer.hpp"
 #include "handlegraph/util.hpp"
 
+#include <algorithm>
 
+
+using std::upper_bound;
+using std::min;
 using std::cerr;
 using std::tie;
 
@@ -11,12 +15,14 @@ typedef map <size_t, OverlappingChild>::iterator overlapping_child_iter;
 
 
 OverlappingOverlapSplicer::OverlappingOverlapSplicer(
-        map<nid_t, OverlappingNodeInfo>& overlapping_overlap_nodes,
-        map <nid_t, set<nid_t> >& parent_to_children,
-        const vector<Subgraph>& subgraphs):
+        OverlappingOverlapNodes& overlapping_overlap_nodes,
+        const Parentage& parentage,
+        const vector<SplicedPaths>& spliced_paths,
+        size_t n_threads):
     overlapping_overlap_nodes(overlapping_overlap_nodes),
-    parent_to_children(parent_to_children),
-    subgraphs(subgraphs)
+    parentage(parentage),
+    spliced_paths(spliced_paths),
+    n_threads(n_threads)
 {}
 
 
@@ -24,27 +30,26 @@ bool OverlappingOverlapSplicer::find_path_info(
         const HandleGraph& gfa_graph,
         size_t biclique_index,
         handle_t handle,
-        PathInfo& path_info,
         string& path_name){
 
-    auto& subgraph = subgraphs[biclique_index];
+    auto& paths = spliced_paths[biclique_index];
 
     bool reversal = false;
 
     // Don't know which side of the biclique this overlap was on until we search for it in the subgraph
-    auto result = subgraph.paths_per_handle[0].find(handle);
+    auto result = paths.find_path_name(0, handle);
 
-    if (result == subgraph.paths_per_handle[0].end()) {
-        result = subgraph.paths_per_handle[1].find(handle);
+    if (result == nullptr) {
+        result = paths.find_path_name(1, handle);
 
-        if (result == subgraph.paths_per_handle[1].end()) {
-            result = subgraph.paths_per_handle[0].find(gfa_graph.flip(handle));
+        if (result == nullptr) {
+            result = paths.find_path_name(0, gfa_graph.flip(handle));
 
-            if (result == subgraph.paths_per_handle[0].end()) {
-                result = subgraph.paths_per_handle[1].find(gfa_graph.flip(handle));
+            if (result == nullptr) {
+                result = paths.find_path_name(1, gfa_graph.flip(handle));
 
                 // Sanity check
-                if (result == subgraph.paths_per_handle[1].end()) {
+                if (result == nullptr) {
                     throw runtime_error("ERROR: node not found in biclique subgraph. Node id: " +
                                         to_string(gfa_graph.get_id(handle)));
                 }
@@ -58,87 +63,133 @@ bool OverlappingOverlapSplicer::find_path_info(
         }
     }
 
-    path_name = subgraph.graph.get_path_name(result->second.path_handle);
-    path_info = result->second;
+    path_name = *result;
 
     return reversal;
 }
 
 
-tuple<handle_t, size_t, size_t, bool> OverlappingOverlapSplicer::seek_to_path_base(
-        MutablePathDeletableHandleGraph& gfa_graph,
-        string& path_name,
-        size_t target_base_index){
-
-    auto path_handle = gfa_graph.get_path_handle(path_name);
-    auto step = gfa_graph.path_begin(path_handle);
+PathOffsetIndex::PathOffsetIndex(const PathHandleGraph& graph, const path_handle_t& path){
+    offsets.emplace_back(0);
 
-    size_t cumulative_index = 0;
-    size_t intra_handle_index = 0;
-    size_t remainder = 0;
-    handle_t step_handle;
+    for (auto h: graph.scan_path(path)){
+        handles.emplace_back(h);
+        offsets.emplace_back(offsets.back() + graph.get_length(h));
+    }
+}
 
-    bool fail = true;
-    while (step != gfa_graph.path_end(path_handle)){
-        step_handle = gfa_graph.get_handle_of_step(step);
-        auto step_length = gfa_graph.get_length(step_handle);
 
-        if (cumulative_index + step_length > target_base_index){
-            intra_handle_index = target_base_index - cumulative_index;
-            fail = false;
-            break;
-        }
-        else{
-            step = gfa_graph.get_next_step(step);
-        }
+tuple<handle_t, size_t, size_t, bool> PathOffsetIndex::seek(size_t target_base_index) const{
+    // The first step that ends after the target. Steps of length 0 are passed over, like they are by walking the path
+    auto result = upper_bound(offsets.begin() + 1, offsets.end(), target_base_index);
 
-        cumulative_index += step_length;
+    if (result == offsets.end()){
+        // Failing to reach the target leaves the walk on the last step
+        handle_t last_handle = handles.empty() ? handle_t() : handles.back();
+        return {last_handle, 0, target_base_index - offsets.back(), true};
     }
 
-    remainder = target_base_index - cumulative_index;
+    size_t i = result - offsets.begin() - 1;
+    size_t intra_handle_index = target_base_index - offsets[i];
 
-    return {step_handle, intra_handle_index, remainder, fail};
+    return {handles[i], intra_handle_index, intra_handle_index, false};
 }
 
 
+tuple<handle_t, size_t, size_t, bool> PathOffsetIndex::seek_reverse(
+        const HandleGraph& graph,
+        size_t target_base_index) const{
 
+    size_t length = offsets.back();
 
-tuple<handle_t, size_t, size_t, bool> OverlappingOverlapSplicer::seek_to_reverse_path_base(
-        MutablePathDeletableHandleGraph& gfa_graph,
-        string& path_name,
-        size_t target_base_index){
+    if (target_base_index >= length){
+        handle_t last_handle = handles.empty() ? handle_t() : graph.flip(handles.front());
+        return {last_handle, 0, target_base_index - length, true};
+    }
+
+    // Counted from the end, the target is this many bases into the forward path
+    size_t forward_index = length - 1 - target_base_index;
+    auto result = upper_bound(offsets.begin() + 1, offsets.end(), forward_index);
+
+    size_t i = result - offsets.begin() - 1;
+    size_t intra_handle_index = target_base_index - (length - offsets[i+1]);
 
-    auto path_handle = gfa_graph.get_path_handle(path_name);
-    auto step = gfa_graph.path_back(path_handle);
+    return {graph.flip(handles[i]), intra_handle_index, intra_handle_index, false};
+}
+
+
+void PathOffsetIndex::update_division(
+        const HandleGraph& graph,
+        const handle_t& divided_handle,
+        const vector<handle_t>& parts){
 
-    size_t cumulative_index = 0;
-    size_t intra_handle_index = 0;
-    size_t remainder = 0;
-    handle_t step_handle;
+    auto node_id = graph.get_id(divided_handle);
 
-    bool fail = true;
-    while (step != gfa_graph.path_front_end(path_handle)){
-        step_handle = gfa_graph.flip(gfa_graph.get_handle_of_step(step));
-        auto step_length = gfa_graph.get_length(step_handle);
+    vector <handle_t> updated_handles;
+    vector <size_t> updated_offsets = {0};
 
-        if (cumulative_index + step_length > target_base_index){
-            intra_handle_index = target_base_index - cumulative_index;
-            fail = false;
-            break;
+    auto append = [&](const handle_t& h){
+        updated_handles.emplace_back(h);
+        updated_offsets.emplace_back(updated_offsets.back() + graph.get_length(h));
+    };
+
+    for (auto& h: handles){
+        if (graph.get_id(h) != node_id){
+            append(h);
+        }
+        else if (h == divided_handle){
+            for (auto& part: parts){
+                append(part);
+            }
         }
         else{
-            step = gfa_graph.get_previous_step(step);
+            // The path traverses the node in the other orientation, so it sees the parts flipped and in reverse
+            for (auto iter = parts.rbegin(); iter != parts.rend(); ++iter){
+                append(graph.flip(*iter));
+            }
         }
+    }
+
+    handles = std::move(updated_handles);
+    offsets = std::move(updated_offsets);
+}
+
+
+PathOffsetIndex& OverlappingOverlapSplicer::get_path_index(
+        MutablePathDeletableHandleGraph& gfa_graph,
+        map<string, PathOffsetIndex>& path_indexes,
+        string& path_name){
+
+    auto result = path_indexes.find(path_name);
 
-        cumulative_index += step_length;
+    if (result == path_indexes.end()){
+        auto path_handle = gfa_graph.get_path_handle(path_name);
+        result = path_indexes.emplace(path_name, PathOffsetIndex(gfa_graph, path_handle)).first;
     }
 
-    remainder = target_base_index - cumulative_index;
+    return result->second;
+}
+
+
+tuple<handle_t, size_t, size_t, bool> OverlappingOverlapSplicer::seek_to_path_base(
+        MutablePathDeletableHandleGraph& gfa_graph,
+        map<string, PathOffsetIndex>& path_indexes,
+        string& path_name,
+        size_t target_base_index){
 
-    return {step_handle, intra_handle_index, remainder, fail};
+    return get_path_index(gfa_graph, path_indexes, path_name).seek(target_base_index);
 }
 
 
+tuple<handle_t, size_t, size_t, bool> OverlappingOverlapSplicer::seek_to_reverse_path_base(
+        MutablePathDeletableHandleGraph& gfa_graph,
+        map<string, PathOffsetIndex>& path_indexes,
+        string& path_name,
+        size_t target_base_index){
+
+    return get_path_index(gfa_graph, path_indexes, path_name).seek_reverse(gfa_graph, target_base_index);
+}
+
 
 void OverlappingOverlapSplicer::find_splice_pairs(
         HandleGraph& gfa_graph,
@@ -202,7 +253,6 @@ void OverlappingOverlapSplicer::find_splice_pairs(
                         //  parent [0] [1] [2] [3] [4] [5] [6]
                         //
 
-                        PathInfo path_info;
                         string left_child_path_name;
                         string right_child_path_name;
 
@@ -213,14 +263,12 @@ void OverlappingOverlapSplicer::find_splice_pairs(
                                 gfa_graph,
                                 left_child.biclique_index,
                                 left_child.handle,
-                                path_info,
                                 left_child_path_name);
 
                         right_reversal = find_path_info(
                                 gfa_graph,
                                 right_child.biclique_index,
                                 right_child.handle,
-                                path_info,
                                 right_child_path_name);
 
                         splice_pair_a.left_reversal = left_reversal;
@@ -266,7 +314,6 @@ void OverlappingOverlapSplicer::find_splice_pairs(
                         //
 
 
-                        PathInfo path_info;
                         string left_child_path_name;
                         string right_child_path_name;
 
@@ -277,14 +324,12 @@ void OverlappingOverlapSplicer::find_splice_pairs(
                                 gfa_graph,
                                 left_child.biclique_index,
                                 left_child.handle,
-                                path_info,
                                 left_child_path_name);
 
                         right_reversal = find_path_info(
                                 gfa_graph,
                                 right_child.biclique_index,
                                 right_child.handle,
-                                path_info,
                                 right_child_path_name);
 
                         splice_pair_a.left_reversal = left_reversal;
@@ -333,14 +378,12 @@ void OverlappingOverlapSplicer::find_splice_pairs(
                     //  parent [0]-[1]-[2]-[3]
                     //
 
-                    PathInfo path_info;
                     string left_child_path_name;
 
                     left_reversal = find_path_info(
                             gfa_graph,
                             oo_child.biclique_index,
                             oo_child.handle,
-                            path_info,
                             left_child_path_name);
 
                     right_reversal = false;
@@ -365,14 +408,12 @@ void OverlappingOverlapSplicer::find_splice_pairs(
                     //  parent [0]-[1]-[2]-[3]
                     //
 
-                    PathInfo path_info;
                     string right_child_path_name;
 
                     right_reversal = find_path_info(
                             gfa_graph,
                             oo_child.biclique_index,
                             oo_child.handle,
-                            path_info,
                             right_child_path_name);
 
                     left_reversal = false;
@@ -399,147 +440,187 @@ void OverlappingOverlapSplicer::find_splice_pairs(
 
 
 void OverlappingOverlapSplicer::splice_overlapping_overlaps(MutablePathDeletableHandleGraph& gfa_graph) {
+    vector <OverlappingNodeInfo*> overlap_infos;
+    for (auto& overlap_info: overlapping_overlap_nodes) {
+        overlap_infos.emplace_back(&overlap_info);
+    }
 
-    for (auto& oo_item: overlapping_overlap_nodes) {
-        auto node_id = oo_item.first;
-        auto& overlap_info = oo_item.second;
-
-        map<handle_t, set<size_t> > division_sites;
-        vector<OverlappingSplicePair> oo_splice_pairs;
-
-        // Find all division points
-        find_splice_pairs(gfa_graph, overlap_info, oo_splice_pairs);
-
-        // Aggregate the splice pairs by the handles that they splice
-        for (auto& splice_pair: oo_splice_pairs) {
-            handle_t left_handle;
-            handle_t right_handle;
-            size_t left_index;
-            size_t right_index;
-            size_t left_remainder;
-            size_t right_remainder;
-            bool left_fail;
-            bool right_fail;
-
-            if (splice_pair.left_reversal) {
-                tie(left_handle, left_index, left_remainder, left_fail) = seek_to_reverse_path_base(
-                        gfa_graph,
-                        splice_pair.left_child_path_name,
-                        splice_pair.left_child_index);
-            }
-            else{
-                tie(left_handle, left_index, left_remainder, left_fail) = seek_to_path_base(
-                        gfa_graph,
-                        splice_pair.left_child_path_name,
-                        splice_pair.left_child_index);
-            }
+    // Finding the splice pairs only reads the graph, so it is done for every OO node in parallel. The pairs are in
+    // terms of path coordinates, which are resolved to handles while splicing one OO node at a time, because OO nodes
+    // can share POA nodes and the IDs of the divided parts depend on the order of the divisions
+    vector <vector <OverlappingSplicePair> > oo_splice_pairs(overlap_infos.size());
 
-            if (splice_pair.right_reversal) {
-                tie(right_handle, right_index, right_remainder, right_fail) = seek_to_reverse_path_base(
-                        gfa_graph,
-                        splice_pair.right_child_path_name,
-                        splice_pair.right_child_index);
-            }
-            else{
-                tie(right_handle, right_index, right_remainder, right_fail) = seek_to_path_base(
-                        gfa_graph,
-                        splice_pair.right_child_path_name,
-                        splice_pair.right_child_index);
-            }
+    atomic <size_t> next_index(0);
+    auto find_all_splice_pairs = [&]() {
+        for (size_t i = next_index.fetch_add(1); i < overlap_infos.size(); i = next_index.fetch_add(1)) {
+            find_splice_pairs(gfa_graph, *overlap_infos[i], oo_splice_pairs[i]);
+        }
+    };
 
-            if (left_index + 1 < gfa_graph.get_length(left_handle) and not left_fail) {
-                division_sites[left_handle].emplace(left_index + 1);
-            }
+    vector<thread> workers;
+    for (size_t t = 1; t < min(n_threads, overlap_infos.size()); t++) {
+        workers.emplace_back(find_all_splice_pairs);
+    }
+    find_all_splice_pairs();
+    for (auto& worker: workers) {
+        worker.join();
+    }
 
-            if (right_index < gfa_graph.get_length(right_handle) and right_index > 0 and not right_fail) {
-                division_sites[right_handle].emplace(right_index);
-            }
+    for (auto& splice_pairs: oo_splice_pairs) {
+        splice_pairs_of_node(gfa_graph, splice_pairs);
+    }
+}
+
+
+void OverlappingOverlapSplicer::splice_pairs_of_node(
+        MutablePathDeletableHandleGraph& gfa_graph,
+        vector<OverlappingSplicePair>& oo_splice_pairs) {
+
+    map<handle_t, set<size_t> > division_sites;
+
+    // Offsets along the paths that this OO node splices, which are kept up to date as handles are divided
+    map<string, PathOffsetIndex> path_indexes;
+
+    // Aggregate the splice pairs by the handles that they splice
+    for (auto& splice_pair: oo_splice_pairs) {
+        handle_t left_handle;
+        handle_t right_handle;
+        size_t left_index;
+        size_t right_index;
+        size_t left_remainder;
+        size_t right_remainder;
+        bool left_fail;
+        bool right_fail;
+
+        if (splice_pair.left_reversal) {
+            tie(left_handle, left_index, left_remainder, left_fail) = seek_to_reverse_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.left_child_path_name,
+                    splice_pair.left_child_index);
+        }
+        else{
+            tie(left_handle, left_index, left_remainder, left_fail) = seek_to_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.left_child_path_name,
+                    splice_pair.left_child_index);
         }
 
-        // Do the divisions in bulk
-        for (auto& item: division_sites) {
-            vector<size_t> sites;
-            for (auto& i: item.second){
-                if (i > 0) {
-                    sites.emplace_back(i);
-                }
-            }
+        if (splice_pair.right_reversal) {
+            tie(right_handle, right_index, right_remainder, right_fail) = seek_to_reverse_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.right_child_path_name,
+                    splice_pair.right_child_index);
+        }
+        else{
+            tie(right_handle, right_index, right_remainder, right_fail) = seek_to_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.right_child_path_name,
+                    splice_pair.right_child_index);
+        }
 
-            gfa_graph.divide_handle(item.first, sites);
+        if (left_index + 1 < gfa_graph.get_length(left_handle) and not left_fail) {
+            division_sites[left_handle].emplace(left_index + 1);
         }
 
-        // Splice each division point
-        // (doesn't really need to use seek_path but also this entire project doesn't really need to exist so...)
-        for (auto& splice_pair: oo_splice_pairs) {
-            handle_t left_handle;
-            handle_t right_handle;
-            size_t left_index;
-            size_t right_index;
-            size_t left_remainder;
-            size_t right_remainder;
-            size_t left_fail;
-            size_t right_fail;
-
-            if (splice_pair.left_reversal) {
-                tie(left_handle, left_index, left_remainder, left_fail) = seek_to_reverse_path_base(
-                        gfa_graph,
-                        splice_pair.left_child_path_name,
-                        splice_pair.left_child_index);
-            } else {
-                tie(left_handle, left_index, left_remainder, left_fail) = seek_to_path_base(
-                        gfa_graph,
-                        splice_pair.left_child_path_name,
-                        splice_pair.left_child_index);
-            }
+        if (right_index < gfa_graph.get_length(right_handle) and right_index > 0 and not right_fail) {
+            division_sites[right_handle].emplace(right_index);
+        }
+    }
 
-            if (splice_pair.right_reversal) {
-                tie(right_handle, right_index, right_remainder, right_fail) = seek_to_reverse_path_base(
-                        gfa_graph,
-                        splice_pair.right_child_path_name,
-                        splice_pair.right_child_index);
-            } else {
-                tie(right_handle, right_index, right_remainder, right_fail) = seek_to_path_base(
-                        gfa_graph,
-                        splice_pair.right_child_path_name,
-                        splice_pair.right_child_index);
+    // Do the divisions in bulk
+    for (auto& item: division_sites) {
+        vector<size_t> sites;
+        for (auto& i: item.second){
+            if (i > 0) {
+                sites.emplace_back(i);
             }
+        }
 
-            //
-            if (not left_fail and not right_fail) {
-                gfa_graph.create_edge(left_handle, right_handle);
-            } else if (left_remainder == 0 and right_remainder == 0){
-                vector <handle_t> left_splice_handles;
-                vector <handle_t> right_splice_handles;
+        auto parts = gfa_graph.divide_handle(item.first, sites);
 
-                if (splice_pair.side == 0) {
-                    gfa_graph.follow_edges(left_handle, true, [&](handle_t h) {
-                        left_splice_handles.emplace_back(h);
-                    });
+        for (auto& path_index: path_indexes) {
+            path_index.second.update_division(gfa_graph, item.first, parts);
+        }
+    }
 
-                    right_splice_handles.emplace_back(right_handle);
-                }
-                else {
-                    gfa_graph.follow_edges(right_handle, false, [&](handle_t h) {
-                        right_splice_handles.emplace_back(h);
-                    });
+    // Splice each division point
+    // (doesn't really need to use seek_path but also this entire project doesn't really need to exist so...)
+    for (auto& splice_pair: oo_splice_pairs) {
+        handle_t left_handle;
+        handle_t right_handle;
+        size_t left_index;
+        size_t right_index;
+        size_t left_remainder;
+        size_t right_remainder;
+        size_t left_fail;
+        size_t right_fail;
+
+        if (splice_pair.left_reversal) {
+            tie(left_handle, left_index, left_remainder, left_fail) = seek_to_reverse_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.left_child_path_name,
+                    splice_pair.left_child_index);
+        } else {
+            tie(left_handle, left_index, left_remainder, left_fail) = seek_to_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.left_child_path_name,
+                    splice_pair.left_child_index);
+        }
 
-                    left_splice_handles.emplace_back(left_handle);
-                }
+        if (splice_pair.right_reversal) {
+            tie(right_handle, right_index, right_remainder, right_fail) = seek_to_reverse_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.right_child_path_name,
+                    splice_pair.right_child_index);
+        } else {
+            tie(right_handle, right_index, right_remainder, right_fail) = seek_to_path_base(
+                    gfa_graph,
+                    path_indexes,
+                    splice_pair.right_child_path_name,
+                    splice_pair.right_child_index);
+        }
 
-                for (auto& l: left_splice_handles){
-                    for (auto& r: right_splice_handles){
-                        gfa_graph.create_edge(l, r);
-                    }
-                }
+        //
+        if (not left_fail and not right_fail) {
+            gfa_graph.create_edge(left_handle, right_handle);
+        } else if (left_remainder == 0 and right_remainder == 0){
+            vector <handle_t> left_splice_handles;
+            vector <handle_t> right_splice_handles;
+
+            if (splice_pair.side == 0) {
+                gfa_graph.follow_edges(left_handle, true, [&](handle_t h) {
+                    left_splice_handles.emplace_back(h);
+                });
+
+                right_splice_handles.emplace_back(right_handle);
             }
-            else{
-                throw runtime_error("ERROR: overlap length is > parent node length by "
-                                    + to_string(std::max(right_remainder, left_remainder)));
+            else {
+                gfa_graph.follow_edges(right_handle, false, [&](handle_t h) {
+                    right_splice_handles.emplace_back(h);
+                });
+
+                left_splice_handles.emplace_back(left_handle);
             }
+
+            for (auto& l: left_splice_handles){
+                for (auto& r: right_splice_handles){
+                    gfa_graph.create_edge(l, r);
+                }
+            }
+        }
+        else{
+            throw runtime_error("ERROR: overlap length is > parent node length by "
+                                + to_string(std::max(right_remainder, left_remainder)));
         }
     }
 }
 
 
-
-}
\ No newline at end of file
+}
@@ -0,0 +1,84 @@
+#include "Parentage.hpp"
+
+#include <algorithm>
+
+
+namespace bluntifier{
+
+
+void Parentage::add_child(nid_t child_node, nid_t parent_node, bool is_terminus){
+    if (size_t(child_node) >= parents.size()){
+        parents.resize(child_node + 1, 0);
+        this->is_terminus.resize(child_node + 1, false);
+    }
+
+    parents[child_node] = parent_node;
+    this->is_terminus[child_node] = is_terminus;
+}
+
+
+void Parentage::index_children(){
+    nid_t max_parent = 0;
+    for (auto parent_node: parents){
+        max_parent = std::max(max_parent, parent_node);
+    }
+
+    // Count the children of each parent, then convert the counts to the start of each parent's range
+    child_starts.assign(max_parent + 2, 0);
+    for (auto parent_node: parents){
+        if (parent_node != 0){
+            child_starts[parent_node + 1]++;
+        }
+    }
+
+    for (size_t i = 1; i < child_starts.size(); i++){
+        child_starts[i] += child_starts[i - 1];
+    }
+
+    // Children are visited in ID order, so each range ends up sorted
+    vector <size_t> next_index(child_starts.begin(), child_starts.end() - 1);
+    child_ids.resize(child_starts.back());
+
+    for (size_t child_node = 0; child_node < parents.size(); child_node++){
+        if (parents[child_node] != 0){
+            child_ids[next_index[parents[child_node]]++] = nid_t(child_node);
+        }
+    }
+}
+
+
+bool Parentage::is_child(nid_t node_id) const{
+    return size_t(node_id) < parents.size() and parents[node_id] != 0;
+}
+
+
+pair<nid_t, bool> Parentage::get_parent(nid_t child_node) const{
+    if (not is_child(child_node)){
+        throw runtime_error("ERROR: node is not a child of any parent node: " + to_string(child_node));
+    }
+
+    return {parents[child_node], is_terminus[child_node]};
+}
+
+
+size_t Parentage::get_child_count(nid_t parent_node) const{
+    if (size_t(parent_node) + 1 >= child_starts.size()){
+        return 0;
+    }
+
+    return child_starts[parent_node + 1] - child_starts[parent_node];
+}
+
+
+void Parentage::for_each_child(nid_t parent_node, const function<void(nid_t child_node)>& f) const{
+    if (size_t(parent_node) + 1 >= child_starts.size()){
+        return;
+    }
+
+    for (size_t i = child_starts[parent_node]; i < child_starts[parent_node + 1]; i++){
+        f(child_ids[i]);
+    }
+}
+
+
+}
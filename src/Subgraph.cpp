@@ -1,5 +1,14 @@
 #include "Subgraph.hpp"
 
+#include <unordered_map>
+#include <algorithm>
+
+using handlegraph::edge_t;
+using std::unordered_map;
+using std::lower_bound;
+using std::max;
+using std::to_string;
+
 
 namespace bluntifier {
 
@@ -9,4 +18,215 @@ PathInfo::PathInfo(path_handle_t path_handle, uint32_t spoa_id, bool biclique_si
         biclique_side(biclique_side) {}
 
 
-}
\ No newline at end of file
+void Subgraph::create_sequence_paths(size_t n_sequences){
+    sequence_paths.reserve(sequence_paths.size() + n_sequences);
+
+    for (size_t s = 0; s < n_sequences; s++){
+        auto path_handle = graph.create_path_handle(to_string(s));
+        sequence_paths.emplace_back(path_handle, s, 0);
+    }
+}
+
+
+void Subgraph::for_each_path(const function<void(const PathInfo& path_info)>& f) const{
+    for (size_t side: {0,1}){
+        for (auto& item: paths_per_handle[side]){
+            f(item.second);
+        }
+    }
+
+    for (auto& path_info: sequence_paths){
+        f(path_info);
+    }
+}
+
+
+vector <path_handle_t> Subgraph::get_paths_by_sequence(size_t n_sequences) const{
+    vector <path_handle_t> paths(n_sequences);
+
+    for_each_path([&](const PathInfo& path_info){
+        paths.at(path_info.spoa_id) = path_info.path_handle;
+    });
+
+    return paths;
+}
+
+
+CompactSubgraph::CompactSubgraph(const Subgraph& subgraph){
+    auto& graph = subgraph.graph;
+
+    unordered_map <nid_t, uint64_t> node_indexes;
+
+    node_ids.reserve(graph.get_node_count());
+    sequence_starts.reserve(graph.get_node_count() + 1);
+
+    graph.for_each_handle([&](const handle_t& h){
+        node_indexes.emplace(graph.get_id(h), node_ids.size());
+        node_ids.emplace_back(graph.get_id(h));
+        sequence_starts.emplace_back(sequence.size());
+        sequence += graph.get_sequence(h);
+    });
+
+    sequence_starts.emplace_back(sequence.size());
+
+    auto encode = [&](const handle_t& h){
+        return 2*node_indexes.at(graph.get_id(h)) + graph.get_is_reverse(h);
+    };
+
+    graph.for_each_edge([&](const edge_t& e){
+        edges.emplace_back(encode(e.first), encode(e.second));
+    });
+
+    step_starts.emplace_back(0);
+
+    // The maps are ordered by handle, so the vectors come out sorted
+    for (size_t side: {0,1}){
+        paths_per_handle[side].reserve(subgraph.paths_per_handle[side].size());
+
+        for (auto& item: subgraph.paths_per_handle[side]){
+            auto& path_info = item.second;
+
+            paths_per_handle[side].emplace_back(item.first, path_names.size());
+            path_names.emplace_back(graph.get_path_name(path_info.path_handle));
+
+            for (auto h: graph.scan_path(path_info.path_handle)){
+                steps.emplace_back(encode(h));
+            }
+
+            step_starts.emplace_back(steps.size());
+        }
+    }
+
+    // Nothing is appended after this, so don't hold on to the growth capacity
+    sequence.shrink_to_fit();
+    edges.shrink_to_fit();
+    steps.shrink_to_fit();
+}
+
+
+int64_t CompactSubgraph::find_path(bool side, const handle_t& handle) const{
+    auto& paths = paths_per_handle[side];
+
+    auto result = lower_bound(paths.begin(), paths.end(), handle,
+                              [](const pair<handle_t, uint32_t>& a, const handle_t& b){
+        return a.first < b;
+    });
+
+    if (result == paths.end() or result->first != handle){
+        return -1;
+    }
+
+    return result->second;
+}
+
+
+size_t CompactSubgraph::get_node_count() const{
+    return node_ids.size();
+}
+
+
+nid_t CompactSubgraph::get_max_node_id() const{
+    nid_t max_node_id = 0;
+
+    for (auto id: node_ids){
+        max_node_id = max(max_node_id, id);
+    }
+
+    return max_node_id;
+}
+
+
+vector <path_handle_t> CompactSubgraph::insert_into(MutablePathMutableHandleGraph& graph, nid_t id_offset) const{
+    auto handles = insert_nodes(graph, id_offset);
+
+    return insert_edges_and_paths(graph, handles);
+}
+
+
+vector <handle_t> CompactSubgraph::insert_nodes(MutablePathMutableHandleGraph& graph, nid_t id_offset) const{
+    vector <handle_t> handles;
+    handles.reserve(node_ids.size());
+
+    for (size_t n = 0; n < node_ids.size(); n++){
+        auto start = sequence_starts[n];
+        auto length = sequence_starts[n+1] - start;
+
+        handles.emplace_back(graph.create_handle(sequence.substr(start, length), node_ids[n] + id_offset));
+    }
+
+    return handles;
+}
+
+
+handle_t decode_handle(const HandleGraph& graph, const vector<handle_t>& handles, uint64_t h){
+    return (h & 1) ? graph.flip(handles[h >> 1]) : handles[h >> 1];
+}
+
+
+vector <path_handle_t> CompactSubgraph::insert_edges_and_paths(
+        MutablePathMutableHandleGraph& graph,
+        const vector<handle_t>& handles) const{
+
+    for (auto& e: edges){
+        graph.create_edge(decode_handle(graph, handles, e.first), decode_handle(graph, handles, e.second));
+    }
+
+    vector <path_handle_t> path_handles;
+    path_handles.reserve(path_names.size());
+
+    for (size_t p = 0; p < path_names.size(); p++){
+        path_handles.emplace_back(graph.create_path_handle(path_names[p]));
+
+        for (size_t s = step_starts[p]; s < step_starts[p+1]; s++){
+            graph.append_step(path_handles.back(), decode_handle(graph, handles, steps[s]));
+        }
+    }
+
+    return path_handles;
+}
+
+
+handle_t CompactSubgraph::get_path_front(
+        size_t path_index,
+        const HandleGraph& graph,
+        const vector<handle_t>& handles) const{
+    return decode_handle(graph, handles, steps[step_starts[path_index]]);
+}
+
+
+handle_t CompactSubgraph::get_path_back(
+        size_t path_index,
+        const HandleGraph& graph,
+        const vector<handle_t>& handles) const{
+    return decode_handle(graph, handles, steps[step_starts[path_index + 1] - 1]);
+}
+
+
+SplicedPaths::SplicedPaths(const CompactSubgraph& subgraph){
+    for (size_t side: {0,1}){
+        path_names_per_handle[side].reserve(subgraph.paths_per_handle[side].size());
+
+        for (auto& item: subgraph.paths_per_handle[side]){
+            path_names_per_handle[side].emplace_back(item.first, subgraph.path_names[item.second]);
+        }
+    }
+}
+
+
+const string* SplicedPaths::find_path_name(bool side, const handle_t& handle) const{
+    auto& paths = path_names_per_handle[side];
+
+    auto result = lower_bound(paths.begin(), paths.end(), handle,
+                              [](const pair<handle_t, string>& a, const handle_t& b){
+        return a.first < b;
+    });
+
+    if (result == paths.end() or result->first != handle){
+        return nullptr;
+    }
+
+    return &result->second;
+}
+
+
+}
@@ -1,13 +1,20 @@
 #include "Bluntifier.hpp"
 
 #include <iostream>
+#include <limits>
+#include <cerrno>
+#include <cstdlib>
 #include <getopt.h>
 
 using bluntifier::Bluntifier;
+using bluntifier::AdjacencyComponent;
+using bluntifier::AlignmentCache;
+using bluntifier::WindowedAligner;
 using std::ifstream;
 using std::cerr;
 using std::cout;
 using std::endl;
+using std::numeric_limits;
 
 
 void print_usage() {
@@ -15,6 +22,24 @@ void print_usage() {
     cerr << endl;
     cerr << "options:" << endl;
     cerr << " -p, --provenance FILEPATH   track origin of bluntified sequences in a table here" << endl;
+    cerr << " -x, --exhaustive-max INT    find optimal bipartitions of non-bipartite adjacency components with up to" << endl;
+    cerr << "                             this many node sides, otherwise use a heuristic. the time doubles with each" << endl;
+    cerr << "                             side, so values above " << AdjacencyComponent::slow_exhaustive_size << " are slow (max " << AdjacencyComponent::max_exhaustive_size_limit << ") [" << AdjacencyComponent::default_max_exhaustive_size << "]" << endl;
+    cerr << " -k, --cut-starts INT        number of randomized local searches for bipartitions of larger" << endl;
+    cerr << "                             non-bipartite adjacency components [" << AdjacencyComponent::default_num_cut_starts << "]" << endl;
+    cerr << " -t, --threads INT           number of threads to use [1]" << endl;
+    cerr << " -a, --aligner NAME          how to align overlaps that are not exact: 'spoa' (partial order alignment)," << endl;
+    cerr << "                             'wfa' (wavefront alignment, for low divergence), or 'auto' to choose per" << endl;
+    cerr << "                             biclique from the divergence of the overlap CIGARs (experimental, may not" << endl;
+    cerr << "                             give the same graph as 'spoa') [spoa]" << endl;
+    cerr << " -A, --adaptive-poa          skip the consensus-seeded second round of POA for bicliques whose" << endl;
+    cerr << "                             sequences are all close to the first round's consensus" << endl;
+    cerr << " -w, --window-min-length INT partial order align overlaps at least this long in windows between exact" << endl;
+    cerr << "                             anchors, in parallel, or 0 to never use windows [" << WindowedAligner::default_min_overlap_length << "]" << endl;
+    cerr << " -c, --align-cache DIR       reuse overlap alignments stored in this directory by previous runs, and" << endl;
+    cerr << "                             store new ones in it" << endl;
+    cerr << " -C, --align-cache-size INT  maximum size of the alignment cache directory in MB, least recently used" << endl;
+    cerr << "                             alignments are removed beyond it [" << AlignmentCache::default_max_directory_bytes/(1024*1024) << "]" << endl;
     cerr << " -V, --verbose               log progress to stderr during execution" << endl;
     cerr << " -v, --version               print the version to stdout and exit" << endl;
     cerr << " -h, --help                  print this help message to stderr and exit" << endl;
@@ -24,16 +49,57 @@ void print_version() {
     cout << "get_blunted version 0.0.2" << endl;
 }
 
+// Parse the argument of a numeric option, printing an error and returning false if it isn't a whole number in range.
+// std::stoul throws on text and silently wraps negative numbers around, so it is not used here
+template <typename T>
+bool parse_count(const string& option_name, const char* text, T& value, T max_value = numeric_limits<T>::max()) {
+    string argument = text;
+    bool is_valid = !argument.empty() && argument.find_first_not_of("0123456789") == string::npos;
+    
+    if (is_valid) {
+        errno = 0;
+        auto parsed = strtoull(text, nullptr, 10);
+        is_valid = errno != ERANGE && parsed <= max_value;
+        value = is_valid ? T(parsed) : value;
+    }
+    
+    if (!is_valid) {
+        cerr << "ERROR: " << option_name << " must be a whole number";
+        if (max_value < numeric_limits<T>::max()) {
+            cerr << " no greater than " << max_value;
+        }
+        cerr << ", got '" << argument << "'" << endl;
+    }
+    
+    return is_valid;
+}
+
 int main(int argc, char **argv){
     
     string provenance_path;
     bool verbose = false;
+    size_t max_exhaustive_size = AdjacencyComponent::default_max_exhaustive_size;
+    size_t num_cut_starts = AdjacencyComponent::default_num_cut_starts;
+    size_t n_threads = 1;
+    string aligner_name = "spoa";
+    bool adaptive_poa = false;
+    size_t min_windowed_overlap_length = WindowedAligner::default_min_overlap_length;
+    string align_cache_directory;
+    uint64_t align_cache_max_bytes = AlignmentCache::default_max_directory_bytes;
     
     int c;
     while (true){
         static struct option long_options[] =
         {
             {"provenance", required_argument, 0, 'p'},
+            {"exhaustive-max", required_argument, 0, 'x'},
+            {"cut-starts", required_argument, 0, 'k'},
+            {"threads", required_argument, 0, 't'},
+            {"aligner", required_argument, 0, 'a'},
+            {"adaptive-poa", no_argument, 0, 'A'},
+            {"window-min-length", required_argument, 0, 'w'},
+            {"align-cache", required_argument, 0, 'c'},
+            {"align-cache-size", required_argument, 0, 'C'},
             {"verbose", no_argument, 0, 'V'},
             {"version", no_argument, 0, 'v'},
             {"help", no_argument, 0, 'h'},
@@ -41,7 +107,7 @@ int main(int argc, char **argv){
         };
         
         int option_index = 0;
-        c = getopt_long (argc, argv, "p:Vvh",
+        c = getopt_long (argc, argv, "p:x:k:t:a:Aw:c:C:Vvh",
                          long_options, &option_index);
         if (c == -1){
             break;
@@ -51,6 +117,43 @@ int main(int argc, char **argv){
             case 'p':
                 provenance_path = optarg;
                 break;
+            case 'x':
+                if (!parse_count("--exhaustive-max", optarg, max_exhaustive_size)) {
+                    return 1;
+                }
+                break;
+            case 'k':
+                if (!parse_count("--cut-starts", optarg, num_cut_starts)) {
+                    return 1;
+                }
+                break;
+            case 't':
+                if (!parse_count("--threads", optarg, n_threads)) {
+                    return 1;
+                }
+                break;
+            case 'a':
+                aligner_name = optarg;
+                break;
+            case 'A':
+                adaptive_poa = true;
+                break;
+            case 'w':
+                if (!parse_count("--window-min-length", optarg, min_windowed_overlap_length)) {
+                    return 1;
+                }
+                break;
+            case 'c':
+                align_cache_directory = optarg;
+                break;
+            case 'C':
+                // in MB, so that it can't overflow once converted to bytes
+                if (!parse_count("--align-cache-size", optarg, align_cache_max_bytes,
+                                 numeric_limits<uint64_t>::max() / (1024 * 1024))) {
+                    return 1;
+                }
+                align_cache_max_bytes *= 1024 * 1024;
+                break;
             case 'V':
                 verbose = true;
                 break;
@@ -88,6 +191,29 @@ int main(int argc, char **argv){
         return 1;
     }
     
+    if (max_exhaustive_size > AdjacencyComponent::max_exhaustive_size_limit) {
+        cerr << "ERROR: exhaustive bipartition is limited to " << AdjacencyComponent::max_exhaustive_size_limit
+             << " node sides" << endl;
+        return 1;
+    }
+    if (max_exhaustive_size > AdjacencyComponent::slow_exhaustive_size) {
+        cerr << "WARNING: exhaustive bipartition of components with more than "
+             << AdjacencyComponent::slow_exhaustive_size << " node sides can take a long time" << endl;
+    }
+    
+    if (num_cut_starts == 0) {
+        cerr << "ERROR: number of bipartition local searches must be at least 1" << endl;
+        return 1;
+    }
+    if (n_threads == 0) {
+        cerr << "ERROR: number of threads must be at least 1" << endl;
+        return 1;
+    }
+    if (aligner_name != "auto" && aligner_name != "spoa" && aligner_name != "wfa") {
+        cerr << "ERROR: aligner must be one of 'auto', 'spoa' or 'wfa'" << endl;
+        return 1;
+    }
+    
     // test input for openability
     if (!ifstream(gfa_path)) {
         cerr << "ERROR: could not open input GFA " << gfa_path << endl;
@@ -102,7 +228,9 @@ int main(int argc, char **argv){
         cerr << endl;
     }
     
-    Bluntifier bluntifier(gfa_path, provenance_path, verbose);
+    Bluntifier bluntifier(gfa_path, provenance_path, verbose, max_exhaustive_size,
+                          num_cut_starts, n_threads, aligner_name, adaptive_poa, min_windowed_overlap_length,
+                          align_cache_directory, align_cache_max_bytes);
     bluntifier.bluntify();
 
     return 0;
@@ -45,6 +45,25 @@ void handle_graph_to_gfa(const HandleGraph& graph, ostream& output_gfa){
 }
 
 
+/// The same, but leaving out the nodes that are excluded and all of their edges
+void handle_graph_to_gfa(const HandleGraph& graph, ostream& output_gfa, const function<bool(nid_t)>& is_excluded){
+
+    output_gfa << "H\tHVN:Z:1.0\n";
+
+    graph.for_each_handle([&](const handle_t& node){
+        if (not is_excluded(graph.get_id(node))) {
+            write_node_to_gfa(graph, node, output_gfa);
+        }
+    });
+
+    graph.for_each_edge([&](const edge_t& edge){
+        if (not is_excluded(graph.get_id(edge.first)) and not is_excluded(graph.get_id(edge.second))) {
+            write_edge_to_gfa(graph, edge, output_gfa);
+        }
+    });
+}
+
+
 // TODO write this method to use the overlaps and id map to write the linkages/sequences in the canonical direction
 // using the canonical names as well, wherever possible
 void handle_graph_to_canonical_gfa(const HandleGraph& graph, const string& output_path){
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+#include "bdsg/hash_graph.hpp"
+#include "AdjacencyComponent.hpp"
+
+using bluntifier::adjacency_components;
+using bluntifier::AdjacencyComponent;
+using bluntifier::bipartition;
+
+using bdsg::HashGraph;
+using handlegraph::handle_t;
+using std::vector;
+using std::cerr;
+using std::endl;
+using std::mt19937_64;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+// microbenchmark for the local search that refines approximate maximum bipartitions
+
+size_t count_edges(const AdjacencyComponent& adj_comp) {
+    size_t count = 0;
+    for (auto side : adj_comp) {
+        adj_comp.for_each_adjacent_side(side, [&](handle_t adj_side) {
+            count += !(side < adj_side);
+            return true;
+        });
+    }
+    return count;
+}
+
+size_t count_edges_across(const AdjacencyComponent& adj_comp,
+                          const bipartition& partition) {
+    size_t count = 0;
+    for (auto side : adj_comp) {
+        adj_comp.for_each_adjacent_side(side, [&](handle_t adj_side) {
+            if (partition.first.count(side) == partition.second.count(adj_side)
+                && !(side < adj_side)) {
+                ++count;
+            }
+            return true;
+        });
+    }
+    return count;
+}
+
+int main(){
+
+    for (size_t num_nodes : {1000, 10000, 100000}) {
+
+        // a random graph where all of the edges are on the right side of the nodes,
+        // so there is one large non-bipartite adjacency component
+        HashGraph graph;
+        vector<handle_t> handles;
+        for (size_t i = 0; i < num_nodes; ++i) {
+            handles.push_back(graph.create_handle("A"));
+        }
+        mt19937_64 gen(num_nodes);
+        for (size_t i = 0; i < 3 * num_nodes; ++i) {
+            handle_t a = handles[gen() % num_nodes];
+            handle_t b = graph.flip(handles[gen() % num_nodes]);
+            if (a != graph.flip(b) && !graph.has_edge(a, b)) {
+                graph.create_edge(a, b);
+            }
+        }
+
+        for (auto& adj_comp : adjacency_components(graph)) {
+            if (adj_comp.size() < num_nodes / 2) {
+                continue;
+            }
+
+            size_t num_edges = count_edges(adj_comp);
+
+            auto start = steady_clock::now();
+            auto partition = adj_comp.maximum_bipartite_partition_apx_1_2();
+            auto apx_done = steady_clock::now();
+            size_t apx_across = count_edges_across(adj_comp, partition);
+
+            auto refine_start = steady_clock::now();
+            adj_comp.refine_apx_partition(partition);
+            auto refine_done = steady_clock::now();
+            size_t refined_across = count_edges_across(adj_comp, partition);
+
+            auto multi_start = steady_clock::now();
+            auto multi_partition = adj_comp.multi_start_maximum_bipartite_partition(8);
+            auto multi_done = steady_clock::now();
+            size_t multi_across = count_edges_across(adj_comp, multi_partition);
+
+            double bound = 0.5 * num_edges + 0.125 * (sqrt(8.0 * num_edges + 1.0) - 1.0);
+
+            cerr << "sides: " << adj_comp.size() << ", edges: " << num_edges << ", Edwards-Erdos bound: " << bound << endl;
+            cerr << "\t1/2-approximation: " << apx_across << " across in " << duration<double>(apx_done - start).count() << " s" << endl;
+            cerr << "\trefinement: " << refined_across << " across in " << duration<double>(refine_done - refine_start).count() << " s" << endl;
+            cerr << "\t8 starts: " << multi_across << " across in " << duration<double>(multi_done - multi_start).count() << " s" << endl;
+
+            if (refined_across < bound) {
+                cerr << "refined partition does not satisfy the Edwards-Erdos bound" << endl;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -22,6 +22,8 @@ using std::sort;
 using std::cerr;
 using std::endl;
 using std::function;
+using std::pair;
+using std::make_pair;
 
 int count_edges_across(const AdjacencyComponent& adj_comp,
                        const bipartition& partition) {
@@ -279,6 +281,74 @@ int main(){
         }
     }
 
+    // tests using a larger complete graph, where the maximum bipartition is a balanced split
+    {
+        HashGraph graph;
+        
+        vector<handle_t> handles;
+        for (size_t i = 0; i < 15; ++i) {
+            handles.push_back(graph.create_handle("A"));
+        }
+        for (size_t i = 0; i < handles.size(); ++i) {
+            for (size_t j = i + 1; j < handles.size(); ++j) {
+                graph.create_edge(handles[i], graph.flip(handles[j]));
+            }
+        }
+        
+        for (auto& adj_comp : adjacency_components(graph)) {
+            if (adj_comp.size() == 1) {
+                // skip over the trivial components
+                continue;
+            }
+            
+            auto partition = adj_comp.exhaustive_maximum_bipartite_partition();
+            
+            if (count_edges_across(adj_comp, partition) != 56) {
+                cerr << "did not identify maximum partition in exhaustive search on complete graph" << endl;
+                return 1;
+            }
+        }
+    }
+    
+    // multi-start local search should not depend on the number of threads
+    {
+        HashGraph graph;
+        
+        vector<handle_t> handles;
+        for (size_t i = 0; i < 30; ++i) {
+            handles.push_back(graph.create_handle("A"));
+        }
+        for (size_t i = 0; i < handles.size(); ++i) {
+            for (size_t j = i + 1; j < handles.size(); ++j) {
+                if ((3 * i + 7 * j) % 5 == 0) {
+                    graph.create_edge(handles[i], graph.flip(handles[j]));
+                }
+            }
+        }
+        
+        for (auto& adj_comp : adjacency_components(graph)) {
+            if (adj_comp.size() == 1) {
+                // skip over the trivial components
+                continue;
+            }
+            
+            auto single_start = adj_comp.maximum_bipartite_partition_apx_1_2();
+            adj_comp.refine_apx_partition(single_start);
+            
+            auto partition = adj_comp.multi_start_maximum_bipartite_partition(8, 1);
+            auto threaded_partition = adj_comp.multi_start_maximum_bipartite_partition(8, 4);
+            
+            if (partition != threaded_partition) {
+                cerr << "multi-start local search depends on the number of threads" << endl;
+                return 1;
+            }
+            if (count_edges_across(adj_comp, partition) < count_edges_across(adj_comp, single_start)) {
+                cerr << "multi-start local search is worse than a single start" << endl;
+                return 1;
+            }
+        }
+    }
+    
     // test using a partition that can only be improved locally using an edge swap
     {
         HashGraph graph;
@@ -364,6 +434,31 @@ int main(){
             cerr << "failed to decompose into bipartite blocks" << endl;
             return 1;
         }
+        
+        // every edge should be in exactly one block
+        for (auto& adj_comp : adjacency_components(graph)) {
+            set<pair<handle_t, handle_t>> comp_edges, block_edges;
+            for (auto side : adj_comp) {
+                adj_comp.for_each_adjacent_side(side, [&](handle_t adj_side) {
+                    comp_edges.emplace(std::min(side, adj_side), std::max(side, adj_side));
+                    return true;
+                });
+            }
+            adj_comp.decompose_into_bipartite_blocks([&](const BipartiteGraph& g) {
+                for (auto lit = g.left_begin(), lend = g.left_end(); lit != lend; ++lit) {
+                    g.for_each_adjacent_side(*lit, [&](handle_t node) {
+                        auto edge = make_pair(std::min(*lit, node), std::max(*lit, node));
+                        success = success && !block_edges.count(edge);
+                        block_edges.insert(edge);
+                    });
+                }
+            });
+            success = success && (comp_edges == block_edges);
+        }
+        if (!success) {
+            cerr << "bipartite blocks do not partition the edges" << endl;
+            return 1;
+        }
     }
     
     cerr << "adjacency components tests successful" << endl;
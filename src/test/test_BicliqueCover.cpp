@@ -760,6 +760,85 @@ int main(){
         }
     }
     
+    // building the Galois trees in parallel gives the same lattice
+    {
+        HashGraph graph;
+        
+        // a chain graph with nested neighborhoods (which is domino-free)
+        vector<handle_t> left, right;
+        for (size_t i = 0; i < 12; ++i) {
+            left.push_back(graph.create_handle("A"));
+            right.push_back(graph.create_handle("A"));
+        }
+        for (size_t i = 0; i < left.size(); ++i) {
+            for (size_t j = 0; j <= i; ++j) {
+                graph.create_edge(left[i], right[j]);
+            }
+        }
+        // and a disjoint simple chain graph to make it non-trivial after simplification
+        handle_t h0 = graph.create_handle("A");
+        handle_t h1 = graph.create_handle("A");
+        handle_t h2 = graph.create_handle("A");
+        handle_t h3 = graph.create_handle("A");
+        graph.create_edge(h0, h2);
+        graph.create_edge(h1, h2);
+        graph.create_edge(h1, h3);
+        left.push_back(h0);
+        left.push_back(h1);
+        right.push_back(h2);
+        right.push_back(h3);
+        
+        bipartition partition;
+        for (auto h : left) {
+            partition.first.insert(h);
+        }
+        for (auto h : right) {
+            partition.second.insert(graph.flip(h));
+        }
+        
+        BipartiteGraph bigraph(graph, partition);
+        vector<pair<handle_t, vector<handle_t>>> simplifications;
+        BipartiteGraph simple = bigraph.simplify(simplifications);
+        
+        GaloisLattice serial_lattice(simple);
+        GaloisLattice parallel_lattice(simple, 4, 0);
+        if (!serial_lattice.is_domino_free() || !parallel_lattice.is_domino_free()) {
+            cerr << "failed to identify chain graph as domino free" << endl;
+            return 1;
+        }
+        if (serial_lattice.biclique_separator() != parallel_lattice.biclique_separator()) {
+            cerr << "parallel Galois lattice construction does not match serial" << endl;
+            return 1;
+        }
+        
+        // add a domino
+        handle_t h4 = graph.create_handle("A");
+        handle_t h5 = graph.create_handle("A");
+        handle_t h6 = graph.create_handle("A");
+        handle_t h7 = graph.create_handle("A");
+        handle_t h8 = graph.create_handle("A");
+        handle_t h9 = graph.create_handle("A");
+        graph.create_edge(h4, h7);
+        graph.create_edge(h4, h8);
+        graph.create_edge(h5, h7);
+        graph.create_edge(h5, h9);
+        graph.create_edge(h6, h7);
+        graph.create_edge(h6, h8);
+        graph.create_edge(h6, h9);
+        partition.first.insert(h4);
+        partition.first.insert(h5);
+        partition.first.insert(h6);
+        partition.second.insert(graph.flip(h7));
+        partition.second.insert(graph.flip(h8));
+        partition.second.insert(graph.flip(h9));
+        
+        BipartiteGraph domino_bigraph(graph, partition);
+        if (GaloisLattice(domino_bigraph, 4, 0).is_domino_free()) {
+            cerr << "parallel Galois lattice construction failed to identify domino" << endl;
+            return 1;
+        }
+    }
+    
     cerr << "biclique cover tests successful" << endl;
     return 0;
 }
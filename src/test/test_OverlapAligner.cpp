@@ -0,0 +1,736 @@
+#include "OverlapAligner.hpp"
+#include "AlignmentCache.hpp"
+#include "unchop.hpp"
+#include "copy_graph.hpp"
+
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <limits>
+
+using bluntifier::OverlapAligner;
+using bluntifier::WavefrontAligner;
+using bluntifier::SpoaAligner;
+using bluntifier::WindowedAligner;
+using bluntifier::make_overlap_aligner;
+using bluntifier::AlignmentCache;
+using bluntifier::SubgraphTemplate;
+using bluntifier::Subgraph;
+using bluntifier::CompactSubgraph;
+using bluntifier::SplicedPaths;
+using bluntifier::PathInfo;
+using bluntifier::Cigar;
+using bluntifier::unchop;
+using bluntifier::copy_path_handle_graph;
+using handlegraph::edge_t;
+
+using std::mt19937;
+using std::min;
+using std::numeric_limits;
+using std::sort;
+using std::set;
+using std::tuple;
+using std::to_string;
+using std::runtime_error;
+using std::cerr;
+using std::endl;
+
+
+size_t edit_distance(const string& a, const string& b){
+    vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); j++) {
+        row[j] = j;
+    }
+
+    for (size_t i = 1; i <= a.size(); i++) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            size_t above = row[j];
+            row[j] = min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1])});
+            diagonal = above;
+        }
+    }
+
+    return row[b.size()];
+}
+
+
+string mutate(const string& sequence, size_t n_edits, mt19937& generator){
+    string bases = "ACGT";
+    string result = sequence;
+
+    for (size_t e = 0; e < n_edits; e++) {
+        size_t position = generator() % (result.size() + 1);
+        size_t type = generator() % 3;
+
+        if (type == 0 and position < result.size()) {
+            result[position] = bases[generator() % 4];
+        }
+        else if (type == 1 and position < result.size()) {
+            result.erase(position, 1);
+        }
+        else {
+            result.insert(position, 1, bases[generator() % 4]);
+        }
+    }
+
+    return result;
+}
+
+
+void test_align_pair(mt19937& generator){
+    string bases = "ACGT";
+
+    for (size_t trial = 0; trial < 500; trial++) {
+        string ref;
+        size_t length = generator() % 60;
+        for (size_t k = 0; k < length; k++) {
+            ref += bases[generator() % 4];
+        }
+
+        string query = mutate(ref, generator() % 8, generator);
+
+        vector<Cigar> operations;
+        if (not WavefrontAligner::align_pair(ref, query, numeric_limits<int64_t>::max(), operations)) {
+            throw runtime_error("FAIL: unbounded alignment of " + query + " to " + ref + " failed");
+        }
+
+        // Replay the alignment and count its cost
+        size_t ref_index = 0;
+        size_t query_index = 0;
+        size_t cost = 0;
+
+        for (auto& c: operations) {
+            for (size_t k = 0; k < c.length; k++) {
+                if (c.type() == '=' or c.type() == 'X') {
+                    if ((ref[ref_index] == query[query_index]) != (c.type() == '=')) {
+                        throw runtime_error("FAIL: wrong match type in alignment of " + query + " to " + ref);
+                    }
+                    ref_index++;
+                    query_index++;
+                }
+                else if (c.type() == 'I') {
+                    query_index++;
+                }
+                else {
+                    ref_index++;
+                }
+            }
+            cost += (c.type() == '=') ? 0 : c.length;
+        }
+
+        if (ref_index != ref.size() or query_index != query.size()) {
+            throw runtime_error("FAIL: alignment of " + query + " to " + ref + " does not span both sequences");
+        }
+
+        if (cost != edit_distance(ref, query)) {
+            throw runtime_error("FAIL: alignment of " + query + " to " + ref + " has cost " + to_string(cost)
+                                + " but the edit distance is " + to_string(edit_distance(ref, query)));
+        }
+
+        int64_t distance = cost;
+        if (WavefrontAligner::edit_distance(ref, query, distance) != distance
+            or (distance > 0 and WavefrontAligner::edit_distance(ref, query, distance - 1) != -1)) {
+            throw runtime_error("FAIL: bounded edit distance of " + query + " to " + ref + " is wrong");
+        }
+
+        vector<Cigar> bounded_operations;
+        if (not WavefrontAligner::align_pair(ref, query, distance, bounded_operations)
+            or (distance > 0 and WavefrontAligner::align_pair(ref, query, distance - 1, bounded_operations))
+            or (distance > 0 and not bounded_operations.empty())) {
+            throw runtime_error("FAIL: bounded alignment of " + query + " to " + ref + " is wrong");
+        }
+    }
+
+    cerr << "PASS: wavefront alignments are optimal" << endl;
+}
+
+
+void align_and_check_paths(OverlapAligner& aligner, const string& name, const vector<string>& sequences){
+    Subgraph subgraph;
+    for (size_t s = 0; s < sequences.size(); s++) {
+        handle_t h = handlegraph::as_handle(s + 1);
+        auto path_handle = subgraph.graph.create_path_handle(to_string(s));
+        subgraph.paths_per_handle[s % 2].emplace(h, PathInfo(path_handle, s, s % 2));
+    }
+
+    aligner.align(sequences, subgraph);
+
+    for (size_t side: {0,1}) {
+        for (auto& item: subgraph.paths_per_handle[side]) {
+            string path_sequence;
+            for (auto h: subgraph.graph.scan_path(item.second.path_handle)) {
+                path_sequence += subgraph.graph.get_sequence(h);
+            }
+
+            if (path_sequence != sequences[item.second.spoa_id]) {
+                throw runtime_error("FAIL: " + name + " path spells " + path_sequence + " instead of "
+                                    + sequences[item.second.spoa_id]);
+            }
+        }
+    }
+}
+
+
+void test_aligner_paths(OverlapAligner& aligner, const string& name, mt19937& generator){
+    string bases = "ACGT";
+
+    for (size_t trial = 0; trial < 50; trial++) {
+        string flank_a;
+        string flank_b;
+        string core;
+        for (size_t k = 0; k < 20; k++) {
+            flank_a += bases[generator() % 4];
+            flank_b += bases[generator() % 4];
+            core += bases[generator() % 4];
+        }
+
+        // Sequences that share exact flanks, with a divergent middle
+        vector<string> sequences;
+        size_t n_sequences = 2 + generator() % 5;
+        for (size_t s = 0; s < n_sequences; s++) {
+            sequences.emplace_back(flank_a + mutate(core, generator() % 4, generator) + flank_b);
+        }
+
+        align_and_check_paths(aligner, name, sequences);
+    }
+
+    cerr << "PASS: " << name << " paths spell their sequences" << endl;
+}
+
+
+void test_frozen_determinism(mt19937& generator){
+    string bases = "ACGT";
+
+    string ancestor;
+    for (size_t k = 0; k < 100; k++) {
+        ancestor += bases[generator() % 4];
+    }
+
+    vector<string> sequences;
+    for (size_t s = 0; s < 12; s++) {
+        sequences.emplace_back(mutate(ancestor, 5, generator));
+    }
+
+    // The graph must not depend on how many threads aligned to the frozen graph
+    vector<string> buffers;
+    for (size_t n_threads: {1, 4}) {
+        SpoaAligner aligner(false, SpoaAligner::default_max_single_pass_divergence, n_threads, 2);
+
+        Subgraph subgraph;
+        for (size_t s = 0; s < sequences.size(); s++) {
+            auto path_handle = subgraph.graph.create_path_handle(to_string(s));
+            subgraph.paths_per_handle[0].emplace(handlegraph::as_handle(s + 1), PathInfo(path_handle, s, 0));
+        }
+
+        aligner.align(sequences, subgraph);
+
+        if (aligner.get_n_frozen() != 1) {
+            throw runtime_error("FAIL: large biclique was not aligned to a frozen graph");
+        }
+
+        buffers.emplace_back();
+        SubgraphTemplate(subgraph).serialize(buffers.back());
+    }
+
+    if (buffers[0] != buffers[1]) {
+        throw runtime_error("FAIL: frozen POA depends on the number of threads");
+    }
+
+    cerr << "PASS: frozen POA is deterministic" << endl;
+}
+
+
+void test_windowed_aligner(mt19937& generator){
+    string bases = "ACGT";
+
+    SpoaAligner spoa_aligner;
+    WindowedAligner windowed_aligner(spoa_aligner, 3);
+
+    for (size_t trial = 0; trial < 4; trial++) {
+        string ancestor;
+        for (size_t k = 0; k < 6000; k++) {
+            ancestor += bases[generator() % 4];
+        }
+
+        vector<string> sequences;
+        for (size_t s = 0; s < 3 + trial; s++) {
+            sequences.emplace_back(mutate(ancestor, 60, generator));
+        }
+
+        auto anchors = WindowedAligner::find_anchors(sequences);
+
+        if (anchors.empty()) {
+            throw runtime_error("FAIL: no anchors found in similar sequences");
+        }
+
+        for (size_t a = 0; a < anchors.size(); a++) {
+            for (size_t s = 0; s < sequences.size(); s++) {
+                size_t window_start = (a == 0) ? 0 : anchors[a - 1][s] + WindowedAligner::anchor_length;
+
+                if (anchors[a][s] < window_start
+                    or sequences[s].compare(anchors[a][s], WindowedAligner::anchor_length, sequences[0],
+                                            anchors[a][0], WindowedAligner::anchor_length) != 0) {
+                    throw runtime_error("FAIL: anchors are not shared and chained");
+                }
+            }
+        }
+
+        align_and_check_paths(windowed_aligner, "windowed", sequences);
+    }
+
+    // Without anchors, the overlap is aligned as a single window
+    align_and_check_paths(windowed_aligner, "windowed", {"ACGTTGCA", "ACGATGCA", "ACGTTGGCA"});
+
+    if (windowed_aligner.get_n_windowed() != 5 or windowed_aligner.get_n_windows() < 9) {
+        throw runtime_error("FAIL: windowed aligner statistics are wrong");
+    }
+
+    cerr << "PASS: windowed paths spell their sequences" << endl;
+}
+
+
+// The node sequences along each path, which identify a graph built from paths up to its node IDs
+vector <vector <string> > get_path_node_sequences(const Subgraph& subgraph){
+    vector <vector <string> > result;
+
+    for (size_t side: {0,1}) {
+        for (auto& item: subgraph.paths_per_handle[side]) {
+            result.emplace_back();
+            for (auto h: subgraph.graph.scan_path(item.second.path_handle)) {
+                result.back().emplace_back(subgraph.graph.get_sequence(h));
+            }
+        }
+    }
+
+    return result;
+}
+
+
+void test_compacted_conversion(mt19937& generator){
+    string bases = "ACGT";
+
+    for (size_t trial = 0; trial < 50; trial++) {
+        string ancestor;
+        for (size_t k = 0; k < 40; k++) {
+            ancestor += bases[generator() % 4];
+        }
+
+        // Some sequences are repeated, and their copies share a distinct representative
+        vector<string> distinct;
+        size_t n_distinct = 1 + generator() % 5;
+        for (size_t d = 0; d < n_distinct; d++) {
+            distinct.emplace_back(mutate(ancestor, generator() % 6, generator));
+        }
+
+        vector<string> sequences;
+        vector<size_t> representatives;
+        for (size_t s = 0; s < n_distinct + 3; s++) {
+            representatives.emplace_back(s < n_distinct ? s : generator() % n_distinct);
+            sequences.emplace_back(distinct[representatives.back()]);
+        }
+
+        auto alignment_engine = spoa::AlignmentEngine::Create(spoa::AlignmentType::kSW, 5, -3, -3, -1);
+        spoa::Graph spoa_graph{};
+        for (auto& sequence: distinct) {
+            auto alignment = alignment_engine->Align(sequence, spoa_graph);
+            spoa_graph.AddAlignment(alignment, sequence);
+        }
+
+        Subgraph compacted;
+        Subgraph unchopped;
+        for (auto subgraph: {&compacted, &unchopped}) {
+            for (size_t s = 0; s < sequences.size(); s++) {
+                auto path_handle = subgraph->graph.create_path_handle(to_string(s));
+                PathInfo path_info(path_handle, s, s % 2);
+                subgraph->paths_per_handle[s % 2].emplace(handlegraph::as_handle(s + 1), path_info);
+            }
+        }
+
+        SpoaAligner::convert_spoa_to_bdsg(spoa_graph, 0, sequences, representatives, compacted);
+
+        // Reference: one node per SPOA node, then unchop
+        unordered_map <uint32_t, handle_t> nodes_created;
+        for (size_t side: {0,1}) {
+            for (auto& item: unchopped.paths_per_handle[side]) {
+                uint32_t spoa_id = representatives[item.second.spoa_id];
+                auto& sequence = sequences[item.second.spoa_id];
+
+                size_t base_index = 0;
+                handle_t previous;
+                for (auto node = spoa_graph.sequences()[spoa_id]; node != nullptr; node = node->Successor(spoa_id)) {
+                    auto iter = nodes_created.find(node->id);
+                    if (iter == nodes_created.end()) {
+                        auto h = unchopped.graph.create_handle(string(1, sequence[base_index]));
+                        iter = nodes_created.emplace(node->id, h).first;
+                    }
+                    if (base_index > 0) {
+                        unchopped.graph.create_edge(previous, iter->second);
+                    }
+                    unchopped.graph.append_step(item.second.path_handle, iter->second);
+                    previous = iter->second;
+                    base_index++;
+                }
+            }
+        }
+        unchop(&unchopped.graph);
+
+        if (compacted.graph.get_node_count() != unchopped.graph.get_node_count()
+            or compacted.graph.get_edge_count() != unchopped.graph.get_edge_count()
+            or get_path_node_sequences(compacted) != get_path_node_sequences(unchopped)) {
+            throw runtime_error("FAIL: compacted conversion differs from conversion and unchop");
+        }
+    }
+
+    cerr << "PASS: compacted conversion matches unchop" << endl;
+}
+
+
+void test_guide_order(mt19937& generator){
+    string bases = "ACGT";
+
+    string first;
+    string second;
+    for (size_t k = 0; k < 200; k++) {
+        first += bases[generator() % 4];
+        second += bases[generator() % 4];
+    }
+
+    // Two unrelated families, interleaved, with the second family the larger one
+    vector<string> sequences = {first, second, mutate(first, 2, generator), mutate(second, 2, generator),
+                                mutate(second, 3, generator)};
+    vector<size_t> distinct_indexes = {0, 1, 2, 3, 4};
+    vector<uint32_t> weights = {1, 1, 1, 1, 1};
+
+    auto order = SpoaAligner::get_guide_order(sequences, distinct_indexes, weights);
+
+    auto sorted_order = order;
+    sort(sorted_order.begin(), sorted_order.end());
+    if (sorted_order != distinct_indexes) {
+        throw runtime_error("FAIL: guide order is not a permutation");
+    }
+
+    // Each family should be added contiguously, starting from the medoid, which is in the larger family
+    vector<size_t> family_of_sequence = {0, 1, 0, 1, 1};
+    vector<size_t> families;
+    for (auto d: order) {
+        families.emplace_back(family_of_sequence[d]);
+    }
+    if (families != vector<size_t>({1, 1, 1, 0, 0})) {
+        throw runtime_error("FAIL: guide order does not group similar sequences");
+    }
+
+    cerr << "PASS: guide order groups similar sequences" << endl;
+}
+
+
+void test_alignment_cache(){
+    vector<string> sequences = {"ACGTTACGTA", "ACGTAACGTA", "ACGTTACCGTA"};
+
+    auto create_paths = [&](Subgraph& subgraph, const vector<string>& path_sequences){
+        for (size_t s = 0; s < path_sequences.size(); s++) {
+            handle_t h = handlegraph::as_handle(s + 1);
+            auto path_handle = subgraph.graph.create_path_handle(to_string(s));
+            subgraph.paths_per_handle[s % 2].emplace(h, PathInfo(path_handle, s, s % 2));
+        }
+    };
+
+    auto check_paths = [&](Subgraph& subgraph, const vector<string>& path_sequences){
+        for (size_t side: {0,1}) {
+            for (auto& item: subgraph.paths_per_handle[side]) {
+                string path_sequence;
+                vector<handle_t> steps;
+                for (auto h: subgraph.graph.scan_path(item.second.path_handle)) {
+                    path_sequence += subgraph.graph.get_sequence(h);
+
+                    if (not steps.empty() and not subgraph.graph.has_edge(steps.back(), h)) {
+                        throw runtime_error("FAIL: cached path steps are not connected by an edge");
+                    }
+                    steps.emplace_back(h);
+                }
+
+                auto& expected = path_sequences[item.second.spoa_id];
+                if (path_sequence != expected) {
+                    throw runtime_error("FAIL: cached path spells " + path_sequence + " instead of " + expected);
+                }
+            }
+        }
+    };
+
+    auto spoa_aligner = make_overlap_aligner("spoa");
+    AlignmentCache cache;
+
+    Subgraph aligned;
+    create_paths(aligned, sequences);
+
+    if (cache.align(*spoa_aligner, sequences, aligned)) {
+        throw runtime_error("FAIL: empty cache returned a subgraph");
+    }
+    check_paths(aligned, sequences);
+
+    // A hit must build exactly the graph that aligning again would
+    Subgraph loaded;
+    create_paths(loaded, sequences);
+
+    if (cache.load("wfa", sequences, loaded)) {
+        throw runtime_error("FAIL: cache returned a subgraph for a different aligner");
+    }
+    if (not cache.align(*spoa_aligner, sequences, loaded)) {
+        throw runtime_error("FAIL: cache did not return a stored subgraph");
+    }
+    check_paths(loaded, sequences);
+
+    Subgraph realigned;
+    create_paths(realigned, sequences);
+    spoa_aligner->align(sequences, realigned);
+
+    auto get_nodes = [&](const Subgraph& subgraph){
+        map <nid_t, string> nodes;
+        subgraph.graph.for_each_handle([&](const handle_t& h){
+            nodes.emplace(subgraph.graph.get_id(h), subgraph.graph.get_sequence(h));
+        });
+        return nodes;
+    };
+
+    if (get_nodes(loaded) != get_nodes(realigned)
+        or loaded.graph.get_edge_count() != realigned.graph.get_edge_count()) {
+        throw runtime_error("FAIL: cached subgraph differs from a new alignment");
+    }
+
+    if (cache.get_n_hits() != 1 or cache.get_n_bases_avoided() != 31) {
+        throw runtime_error("FAIL: cache statistics are wrong");
+    }
+
+    // POA depends on the order of the sequences, so the same sequences in another order are aligned again
+    vector<string> reordered_sequences(sequences.rbegin(), sequences.rend());
+
+    Subgraph reordered;
+    create_paths(reordered, reordered_sequences);
+    if (cache.align(*spoa_aligner, reordered_sequences, reordered)) {
+        throw runtime_error("FAIL: reordered sequences were loaded from the cache");
+    }
+    check_paths(reordered, reordered_sequences);
+
+    // Serialized templates must round trip, and damaged ones must be rejected
+    SubgraphTemplate subgraph_template(*spoa_aligner, sequences);
+    string buffer;
+    subgraph_template.serialize(buffer);
+
+    SubgraphTemplate parsed;
+    if (not parsed.deserialize(buffer.data(), buffer.size()) or not parsed.is_valid_for(sequences)) {
+        throw runtime_error("FAIL: serialized template did not round trip");
+    }
+
+    SubgraphTemplate truncated;
+    if (truncated.deserialize(buffer.data(), buffer.size() - 1)) {
+        throw runtime_error("FAIL: truncated template was accepted");
+    }
+
+    auto other_sequences = sequences;
+    other_sequences[1][3] = 'C';
+    if (parsed.is_valid_for(other_sequences)) {
+        throw runtime_error("FAIL: template was accepted for different sequences");
+    }
+
+    // Memory is bounded by evicting the least recently used entries, but pinned entries stay until they are loaded
+    SubgraphTemplate other_template(*spoa_aligner, other_sequences);
+
+    // Room for either entry, but not both
+    auto max_memory_bytes = std::max(subgraph_template.get_size(), other_template.get_size()) + 16;
+
+    AlignmentCache small_cache;
+    small_cache.set_max_memory_bytes(max_memory_bytes);
+
+    small_cache.store("spoa", sequences, subgraph_template, true);
+    small_cache.store("spoa", other_sequences, other_template);
+
+    if (not small_cache.contains("spoa", sequences)
+        or small_cache.contains("spoa", other_sequences)) {
+        throw runtime_error("FAIL: pinned entry was not kept");
+    }
+
+    Subgraph pinned;
+    create_paths(pinned, sequences);
+    if (not small_cache.load("spoa", sequences, pinned)) {
+        throw runtime_error("FAIL: pinned entry was not loaded");
+    }
+    check_paths(pinned, sequences);
+
+    small_cache.store("spoa", other_sequences, other_template);
+
+    if (small_cache.contains("spoa", sequences)
+        or not small_cache.contains("spoa", other_sequences)
+        or small_cache.get_memory_bytes() > max_memory_bytes) {
+        throw runtime_error("FAIL: least recently used entry was not evicted");
+    }
+
+    // An entry that is pinned for a prediction that turns out wrong is never loaded, so it is unpinned once the point
+    // where it would have been used has passed. Until then it is kept
+    AlignmentCache mispredicted_cache;
+    mispredicted_cache.set_max_memory_bytes(max_memory_bytes);
+
+    mispredicted_cache.store("spoa", sequences, subgraph_template, true, 0);
+    mispredicted_cache.unpin(0);
+    mispredicted_cache.store("spoa", other_sequences, other_template);
+
+    if (not mispredicted_cache.contains("spoa", sequences) or mispredicted_cache.contains("spoa", other_sequences)) {
+        throw runtime_error("FAIL: pinned entry was unpinned before it could be used");
+    }
+
+    mispredicted_cache.unpin(1);
+    if (not mispredicted_cache.has_room()) {
+        throw runtime_error("FAIL: unused pinned entry still takes up room");
+    }
+
+    mispredicted_cache.store("spoa", other_sequences, other_template);
+
+    if (mispredicted_cache.contains("spoa", sequences) or not mispredicted_cache.contains("spoa", other_sequences)
+        or mispredicted_cache.get_n_pinned_hits() != 0) {
+        throw runtime_error("FAIL: unused pinned entry was not evicted");
+    }
+
+    cerr << "PASS: cached alignments are reproduced" << endl;
+}
+
+
+// Everything about the graph that splicing depends on, in terms of node IDs and path names
+tuple <map <nid_t, string>, set <tuple <nid_t, bool, nid_t, bool> >, map <string, vector <pair <nid_t, bool> > > >
+describe_graph(const HashGraph& graph){
+    map <nid_t, string> nodes;
+    set <tuple <nid_t, bool, nid_t, bool> > edges;
+    map <string, vector <pair <nid_t, bool> > > paths;
+
+    graph.for_each_handle([&](const handle_t& h){
+        nodes.emplace(graph.get_id(h), graph.get_sequence(h));
+    });
+
+    graph.for_each_edge([&](const edge_t& e){
+        // Store each edge in the orientation that comes first, so that both directions compare equal
+        auto a = e;
+        auto b = edge_t(graph.flip(e.second), graph.flip(e.first));
+        auto forward = tuple <nid_t, bool, nid_t, bool>(
+                graph.get_id(a.first), graph.get_is_reverse(a.first),
+                graph.get_id(a.second), graph.get_is_reverse(a.second));
+        auto backward = tuple <nid_t, bool, nid_t, bool>(
+                graph.get_id(b.first), graph.get_is_reverse(b.first),
+                graph.get_id(b.second), graph.get_is_reverse(b.second));
+        edges.emplace(min(forward, backward));
+    });
+
+    graph.for_each_path_handle([&](const path_handle_t& p){
+        auto& steps = paths[graph.get_path_name(p)];
+        for (auto h: graph.scan_path(p)) {
+            steps.emplace_back(graph.get_id(h), graph.get_is_reverse(h));
+        }
+    });
+
+    return {nodes, edges, paths};
+}
+
+
+void test_compact_subgraph(mt19937& generator){
+    string bases = "ACGT";
+    SpoaAligner aligner;
+
+    for (size_t trial = 0; trial < 20; trial++) {
+        string ancestor;
+        for (size_t k = 0; k < 60; k++) {
+            ancestor += bases[generator() % 4];
+        }
+
+        vector<string> sequences;
+        size_t n_sequences = 2 + generator() % 5;
+        for (size_t s = 0; s < n_sequences; s++) {
+            sequences.emplace_back(mutate(ancestor, generator() % 8, generator));
+        }
+
+        Subgraph subgraph;
+        for (size_t s = 0; s < sequences.size(); s++) {
+            handle_t h = handlegraph::as_handle(2*(s + 1) + (s % 3 == 0));
+            auto path_handle = subgraph.graph.create_path_handle(to_string(s) + "_" + to_string(s % 2));
+            subgraph.paths_per_handle[s % 2].emplace(h, PathInfo(path_handle, s, s % 2));
+        }
+
+        aligner.align(sequences, subgraph);
+
+        CompactSubgraph compact_subgraph(subgraph);
+
+        // Both graphs already have some nodes, so the inserted IDs have to be offset
+        HashGraph copied;
+        HashGraph inserted;
+        for (auto graph: {&copied, &inserted}) {
+            auto a = graph->create_handle("GATTACA", 3);
+            auto b = graph->create_handle("CAT", 8);
+            graph->create_edge(a, graph->flip(b));
+        }
+
+        subgraph.graph.increment_node_ids(copied.max_node_id());
+        copy_path_handle_graph(&subgraph.graph, &copied);
+
+        auto path_handles = compact_subgraph.insert_into(inserted, inserted.max_node_id());
+
+        if (describe_graph(copied) != describe_graph(inserted)
+            or compact_subgraph.get_node_count() != subgraph.graph.get_node_count()) {
+            throw runtime_error("FAIL: inserting a compact subgraph differs from copying it");
+        }
+
+        SplicedPaths spliced_paths(compact_subgraph);
+
+        for (size_t side: {0,1}) {
+            for (auto& item: subgraph.paths_per_handle[side]) {
+                auto p = compact_subgraph.find_path(side, item.first);
+                auto name = subgraph.graph.get_path_name(item.second.path_handle);
+                auto spliced_name = spliced_paths.find_path_name(side, item.first);
+
+                if (p < 0 or compact_subgraph.path_names[p] != name or inserted.get_path_name(path_handles[p]) != name
+                    or compact_subgraph.find_path(1 - side, item.first) >= 0
+                    or spliced_name == nullptr or *spliced_name != name
+                    or spliced_paths.find_path_name(1 - side, item.first) != nullptr) {
+                    throw runtime_error("FAIL: compact subgraph path lookup is wrong for " + name);
+                }
+            }
+        }
+    }
+
+    cerr << "PASS: compact subgraphs insert the same graph as copying" << endl;
+}
+
+
+int main(){
+    mt19937 generator(37);
+
+    test_align_pair(generator);
+
+    WavefrontAligner wavefront_aligner;
+    SpoaAligner spoa_aligner;
+    SpoaAligner adaptive_spoa_aligner(true, 0.05);
+    SpoaAligner frozen_spoa_aligner(false, SpoaAligner::default_max_single_pass_divergence, 3, 2);
+
+    test_aligner_paths(wavefront_aligner, "wfa", generator);
+    test_aligner_paths(spoa_aligner, "spoa", generator);
+    test_aligner_paths(adaptive_spoa_aligner, "adaptive spoa", generator);
+    test_aligner_paths(frozen_spoa_aligner, "frozen spoa", generator);
+
+    if (adaptive_spoa_aligner.get_n_single_pass() + adaptive_spoa_aligner.get_n_two_pass() != 50
+        or spoa_aligner.get_n_single_pass() != 0) {
+        throw runtime_error("FAIL: POA pass statistics are wrong");
+    }
+
+    // With no edits allowed, every biclique with a mismatch goes to POA instead
+    WavefrontAligner strict_wavefront_aligner(spoa_aligner, 0, 0);
+    test_aligner_paths(strict_wavefront_aligner, "wfa with fallback", generator);
+
+    if (strict_wavefront_aligner.get_n_fallbacks() == 0 or wavefront_aligner.get_n_fallbacks() != 0) {
+        throw runtime_error("FAIL: wavefront aligner did not fall back exactly when it should have");
+    }
+
+    test_frozen_determinism(generator);
+    test_windowed_aligner(generator);
+    test_compacted_conversion(generator);
+    test_compact_subgraph(generator);
+    test_guide_order(generator);
+    test_alignment_cache();
+
+    return 0;
+}
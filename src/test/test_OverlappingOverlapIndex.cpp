@@ -0,0 +1,104 @@
+#include "Bluntifier.hpp"
+#include "utility.hpp"
+
+#include <iostream>
+
+using bluntifier::Bluntifier;
+using bluntifier::OverlappingOverlapIndex;
+using bluntifier::parent_path;
+using bluntifier::join_paths;
+
+using std::runtime_error;
+using std::to_string;
+using std::string;
+using std::vector;
+using std::cerr;
+using std::endl;
+using std::get;
+
+
+int main(){
+    string script_path = __FILE__;
+    string project_directory = parent_path(script_path, 3);
+
+    vector <string> relative_gfa_paths = {
+            "/data/test/overlapping_overlaps.gfa",
+            "/data/test/overlapping_overlaps_flanking_biclique.gfa",
+            "/data/test/overlapping_overlaps_flanking_biclique_less_reversal.gfa",
+            "/data/test/overlapping_overlaps_full_node.gfa",
+            "/data/test/overlapping_overlaps_gap.gfa",
+            "/data/test/overlapping_overlaps_parent_material.gfa"
+    };
+
+    size_t n_oo_parents = 0;
+    size_t n_oo_children = 0;
+    size_t n_children = 0;
+    size_t n_children_listed = 0;
+
+    for (auto& relative_gfa_path: relative_gfa_paths) {
+        string absolute_gfa_path = join_paths(project_directory, relative_gfa_path);
+
+        Bluntifier bluntifier(absolute_gfa_path, "", false);
+        bluntifier.duplicate_termini();
+
+        auto& graph = bluntifier.get_graph();
+        auto& parentage = bluntifier.get_parentage();
+        auto& overlapping_overlap_nodes = bluntifier.get_overlapping_overlap_nodes();
+
+        OverlappingOverlapIndex index(graph, parentage, overlapping_overlap_nodes);
+
+        // Also ask for IDs beyond the graph, which have no role
+        for (nid_t node_id = 1; node_id <= graph.max_node_id() + 1; node_id++) {
+            auto roles = index.get_roles(node_id);
+
+            if (graph.has_node(node_id)) {
+                auto expected_roles = OverlappingOverlapIndex::find_roles(
+                        graph,
+                        parentage,
+                        overlapping_overlap_nodes,
+                        node_id);
+
+                if (roles != expected_roles) {
+                    throw runtime_error("FAIL: wrong roles for node " + to_string(node_id) + " in "
+                                        + relative_gfa_path);
+                }
+            }
+            else if (get<0>(roles) or get<1>(roles)) {
+                throw runtime_error("FAIL: roles found for missing node " + to_string(node_id));
+            }
+
+            n_oo_parents += get<0>(roles);
+            n_oo_children += get<1>(roles);
+
+            // The children of each parent should be exactly the nodes that name it as their parent, in ascending order
+            nid_t prev_child = 0;
+            parentage.for_each_child(node_id, [&](nid_t child_node){
+                if (child_node <= prev_child or parentage.get_parent(child_node).first != node_id) {
+                    throw runtime_error("FAIL: wrong children for parent " + to_string(node_id) + " in "
+                                        + relative_gfa_path);
+                }
+                prev_child = child_node;
+                n_children_listed++;
+            });
+
+            n_children += parentage.is_child(node_id);
+        }
+    }
+
+    if (n_children_listed != n_children) {
+        throw runtime_error("FAIL: " + to_string(n_children) + " children but " + to_string(n_children_listed)
+                            + " are listed under their parents");
+    }
+
+    // Make sure that the graphs actually exercise both roles. In overlapping_overlaps_parent_material.gfa, the overlaps
+    // that are left after removing the overlapping one cover the node exactly, so the rest of it is a separate child
+    if (n_oo_children == 0 or n_oo_parents == 0) {
+        throw runtime_error("FAIL: test graphs have " + to_string(n_oo_parents) + " overlapping overlap parent nodes "
+                            "and " + to_string(n_oo_children) + " children, expected some of each");
+    }
+
+    cerr << "PASS: overlapping overlap index matches brute force (" << n_oo_parents << " parent nodes, "
+         << n_oo_children << " children)" << endl;
+
+    return 0;
+}
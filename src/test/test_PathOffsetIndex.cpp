@@ -0,0 +1,133 @@
+#include "OverlappingOverlapSplicer.hpp"
+#include "bdsg/hash_graph.hpp"
+
+#include <iostream>
+#include <random>
+
+using bluntifier::PathOffsetIndex;
+using bdsg::HashGraph;
+using handlegraph::path_handle_t;
+
+using std::mt19937;
+using std::runtime_error;
+using std::to_string;
+using std::string;
+using std::vector;
+using std::tuple;
+using std::cerr;
+using std::endl;
+
+
+// Walk the path one step at a time, as the splicer used to
+tuple<handle_t, size_t, size_t, bool> walk_to_path_base(
+        const HashGraph& graph,
+        const path_handle_t& path_handle,
+        size_t target_base_index,
+        bool reverse){
+
+    vector <handle_t> steps;
+    for (auto h: graph.scan_path(path_handle)) {
+        steps.emplace_back(h);
+    }
+
+    if (reverse) {
+        vector <handle_t> reversed_steps;
+        for (auto iter = steps.rbegin(); iter != steps.rend(); ++iter) {
+            reversed_steps.emplace_back(graph.flip(*iter));
+        }
+        steps = reversed_steps;
+    }
+
+    size_t cumulative_index = 0;
+    size_t intra_handle_index = 0;
+    handle_t step_handle;
+
+    bool fail = true;
+    for (auto& h: steps) {
+        step_handle = h;
+        auto step_length = graph.get_length(step_handle);
+
+        if (cumulative_index + step_length > target_base_index) {
+            intra_handle_index = target_base_index - cumulative_index;
+            fail = false;
+            break;
+        }
+
+        cumulative_index += step_length;
+    }
+
+    return {step_handle, intra_handle_index, target_base_index - cumulative_index, fail};
+}
+
+
+void check_seeks(const HashGraph& graph, const path_handle_t& path_handle, const PathOffsetIndex& index){
+    size_t length = 0;
+    for (auto h: graph.scan_path(path_handle)) {
+        length += graph.get_length(h);
+    }
+
+    for (size_t target = 0; target < length + 3; target++) {
+        if (index.seek(target) != walk_to_path_base(graph, path_handle, target, false)) {
+            throw runtime_error("FAIL: forward seek to " + to_string(target) + " differs from walking the path");
+        }
+        if (index.seek_reverse(graph, target) != walk_to_path_base(graph, path_handle, target, true)) {
+            throw runtime_error("FAIL: reverse seek to " + to_string(target) + " differs from walking the path");
+        }
+    }
+}
+
+
+int main(){
+    mt19937 generator(47);
+    string bases = "ACGT";
+
+    for (size_t trial = 0; trial < 50; trial++) {
+        HashGraph graph;
+
+        vector <handle_t> nodes;
+        size_t n_nodes = 1 + generator() % 6;
+        for (size_t n = 0; n < n_nodes; n++) {
+            string sequence;
+            size_t length = 1 + generator() % 12;
+            for (size_t b = 0; b < length; b++) {
+                sequence += bases[generator() % 4];
+            }
+            nodes.emplace_back(graph.create_handle(sequence));
+        }
+
+        // Nodes can be visited more than once, in either orientation
+        auto path_handle = graph.create_path_handle("path");
+        size_t n_steps = 1 + generator() % 8;
+        for (size_t s = 0; s < n_steps; s++) {
+            auto h = nodes[generator() % nodes.size()];
+            graph.append_step(path_handle, (generator() % 2) ? graph.flip(h) : h);
+        }
+
+        PathOffsetIndex index(graph, path_handle);
+        check_seeks(graph, path_handle, index);
+
+        for (size_t d = 0; d < 3; d++) {
+            auto h = nodes[generator() % nodes.size()];
+            h = (generator() % 2) ? graph.flip(h) : h;
+
+            auto length = graph.get_length(h);
+            if (length < 2) {
+                continue;
+            }
+
+            vector <size_t> sites = {1 + generator() % (length - 1)};
+            auto parts = graph.divide_handle(h, sites);
+            index.update_division(graph, h, parts);
+
+            for (auto& part: parts) {
+                nodes.emplace_back(graph.forward(part));
+            }
+
+            check_seeks(graph, path_handle, index);
+        }
+    }
+
+    cerr << "PASS: path offset index seeks match walking the path, also after dividing handles" << endl;
+
+    return 0;
+}
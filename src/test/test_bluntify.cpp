@@ -0,0 +1,124 @@
+#include "Bluntifier.hpp"
+#include "gfa_to_handle.hpp"
+#include "utility.hpp"
+
+#include "bdsg/hash_graph.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <deque>
+
+using bluntifier::Bluntifier;
+using bluntifier::IncrementalIdMap;
+using bluntifier::OverlapMap;
+using bluntifier::gfa_to_path_handle_graph_in_memory;
+using bluntifier::parent_path;
+using bluntifier::join_paths;
+using handlegraph::handle_t;
+using bdsg::HashGraph;
+
+using std::unordered_set;
+using std::stringstream;
+using std::streambuf;
+using std::runtime_error;
+using std::string;
+using std::to_string;
+using std::vector;
+using std::deque;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+// Bluntify a GFA and load the blunt graph that it writes to stdout
+void bluntify(Bluntifier& bluntifier, HashGraph& blunt_graph){
+    stringstream output;
+    streambuf* stdout_buffer = cout.rdbuf(output.rdbuf());
+
+    bluntifier.bluntify();
+
+    cout.rdbuf(stdout_buffer);
+
+    IncrementalIdMap<string> id_map;
+    OverlapMap overlaps;
+    gfa_to_path_handle_graph_in_memory(output, blunt_graph, id_map, overlaps);
+}
+
+
+// Is there a walk from a node containing the first sequence to a node containing the second one?
+bool has_walk(const HashGraph& graph, const string& from, const string& to){
+    deque<handle_t> queue;
+    unordered_set<handle_t> visited;
+
+    graph.for_each_handle([&](const handle_t& h){
+        for (auto oriented: {h, graph.flip(h)}) {
+            if (graph.get_sequence(oriented).find(from) != string::npos) {
+                queue.emplace_back(oriented);
+                visited.emplace(oriented);
+            }
+        }
+    });
+
+    while (not queue.empty()) {
+        auto h = queue.front();
+        queue.pop_front();
+
+        if (graph.get_sequence(h).find(to) != string::npos) {
+            return true;
+        }
+
+        graph.follow_edges(h, false, [&](const handle_t& next){
+            if (visited.count(next) == 0) {
+                visited.emplace(next);
+                queue.emplace_back(next);
+            }
+        });
+    }
+
+    return false;
+}
+
+
+int main(){
+    string script_path = __FILE__;
+    string project_directory = parent_path(script_path, 3);
+
+    // The overlap G->E has a CIGAR (4M) whose columns all mismatch, so it can't be used to build the subgraph of the
+    // star biclique at E, and G has to stay connected to E after bluntifying
+    {
+        string gfa_path = join_paths(project_directory, "/data/test/overlapping_overlaps_gap.gfa");
+
+        Bluntifier bluntifier(gfa_path, "", false);
+        HashGraph blunt_graph;
+        bluntify(bluntifier, blunt_graph);
+
+        if (not has_walk(blunt_graph, "TTTT", "AAAAAAA")) {
+            throw runtime_error("FAIL: the adjacency G->E is missing from the blunt graph of " + gfa_path);
+        }
+    }
+
+    // A 3x3 biclique whose edges are listed in mixed orientations, so some of them are flipped when the biclique is
+    // harmonized. The overlap sequences must be predicted for the flipped edges, so that the one biclique that needs
+    // POA is aligned in the background and picked up from the cache
+    {
+        string gfa_path = join_paths(project_directory, "/data/test/reversing_biclique.gfa");
+
+        Bluntifier bluntifier(gfa_path, "", false);
+        HashGraph blunt_graph;
+        bluntify(bluntifier, blunt_graph);
+
+        auto& alignment_cache = bluntifier.get_alignment_cache();
+
+        if (bluntifier.get_n_prealigned() != 1
+            or alignment_cache.get_n_pinned_hits() != 1
+            or alignment_cache.get_n_hits() != 0) {
+            throw runtime_error("FAIL: " + to_string(bluntifier.get_n_prealigned()) + " bicliques were aligned in the "
+                                "background and " + to_string(alignment_cache.get_n_pinned_hits()) + " were used, "
+                                "expected 1 and 1, in " + gfa_path);
+        }
+    }
+
+    cerr << "PASS" << endl;
+
+    return 0;
+}
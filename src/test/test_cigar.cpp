@@ -5,6 +5,7 @@
 using std::to_string;
 using std::ifstream;
 using std::cerr;
+using std::tuple;
 
 using bluntifier::parent_path;
 using bluntifier::join_paths;
@@ -182,6 +183,45 @@ int main(){
         }
     }
 
+    // An overlap that starts in the middle of the ref node, as the suffix overlap of a longer node does. Swapping the
+    // ref and query start indexes would compare the wrong bases and read past the end of the query
+    string long_ref = "TTACGT";
+    Alignment mid_node(mismatch_vs_ref);
+    auto mid_node_operations = mid_node.explicitize_mismatches(long_ref, mismatch, 2, 0);
+
+    if (mid_node_operations.size() != cigar_mismatch_vs_ref_explicit.size()){
+        throw runtime_error("FAIL: explicitized mid-node overlap has the wrong number of operations");
+    }
+    for (size_t i=0; i<cigar_mismatch_vs_ref_explicit.size(); i++){
+        if (mid_node_operations[i].code != cigar_mismatch_vs_ref_explicit[i].code
+            or mid_node_operations[i].length != cigar_mismatch_vs_ref_explicit[i].length){
+            throw runtime_error("FAIL: explicitized mid-node overlap doesn't agree with truth set");
+        }
+    }
+
+    // Indels are copied whole, and the bases after them are still compared at the right indexes, including when the
+    // alignment ends with an indel
+    vector <tuple <string, string, string, vector<Cigar> > > indel_cases = {
+            {"ACGTAC", "ACTAC", "2M1D3M", {Cigar(2,'='), Cigar(1,'D'), Cigar(3,'=')}},
+            {"ACGTAC", "ACAT", "2M2D2M", {Cigar(2,'='), Cigar(2,'D'), Cigar(1,'='), Cigar(1,'X')}},
+            {"ACGT", "ACAAGT", "2M2I2M", {Cigar(2,'='), Cigar(2,'I'), Cigar(2,'=')}},
+            {"ACGTA", "ACGT", "4M1D", {Cigar(4,'='), Cigar(1,'D')}},
+    };
+
+    for (auto& [indel_ref, indel_query, indel_cigar, truth]: indel_cases){
+        Alignment indel_alignment(indel_cigar);
+        auto indel_operations = indel_alignment.explicitize_mismatches(indel_ref, indel_query);
+
+        bool agrees = indel_operations.size() == truth.size();
+        for (size_t i=0; agrees and i<truth.size(); i++){
+            agrees = indel_operations[i].code == truth[i].code and indel_operations[i].length == truth[i].length;
+        }
+
+        if (not agrees){
+            throw runtime_error("FAIL: explicitized " + indel_cigar + " doesn't agree with truth set");
+        }
+    }
+
     cerr << "\nPASS\n";
     return 0;
 }
@@ -1,19 +1,30 @@
 #include "bdsg/packed_graph.hpp"
+#include "bdsg/hash_graph.hpp"
 #include "gfa_to_handle.hpp"
 #include "handle_to_gfa.hpp"
 #include "utility.hpp"
 #include "IncrementalIdMap.hpp"
 #include "OverlapMap.hpp"
 
+#include <sstream>
+#include <set>
+
 using handlegraph::handle_t;
 using bdsg::PackedGraph;
+using bdsg::HashGraph;
 using std::ifstream;
 using std::ofstream;
+using std::stringstream;
+using std::set;
+using std::cerr;
+using std::endl;
 
 using bluntifier::gfa_to_path_handle_graph_in_memory;
 using bluntifier::gfa_to_path_handle_graph;
 using bluntifier::gfa_to_handle_graph;
 using bluntifier::handle_graph_to_gfa;
+using bluntifier::write_node_to_gfa;
+using bluntifier::write_edge_to_gfa;
 using bluntifier::parent_path;
 using bluntifier::join_paths;
 using bluntifier::IncrementalIdMap;
@@ -21,6 +32,72 @@ using bluntifier::OverlapMap;
 using bluntifier::Alignment;
 
 
+void test_excluded_nodes(){
+    HashGraph graph;
+
+    auto a = graph.create_handle("ACGT");
+    auto b = graph.create_handle("GG");
+    auto c = graph.create_handle("TTA");
+    auto d = graph.create_handle("C");
+
+    graph.create_edge(a, b);
+    graph.create_edge(graph.flip(b), c);
+    graph.create_edge(c, graph.flip(d));
+    graph.create_edge(a, d);
+    graph.create_edge(b, b);
+
+    auto excluded_id = graph.get_id(b);
+    auto is_excluded = [&](nid_t id){
+        return id == excluded_id;
+    };
+
+    stringstream output;
+    handle_graph_to_gfa(graph, output, is_excluded);
+
+    set<string> lines;
+    string line;
+    while (getline(output, line)){
+        lines.insert(line);
+    }
+
+    auto to_line = [](const stringstream& s){
+        auto text = s.str();
+        return text.substr(0, text.size() - 1);
+    };
+
+    // Every S line and L line that doesn't touch the excluded node is written, and none of the others
+    size_t n_expected = 1;
+    graph.for_each_handle([&](const handle_t& h){
+        stringstream s;
+        write_node_to_gfa(graph, h, s);
+
+        bool is_kept = not is_excluded(graph.get_id(h));
+        if (lines.count(to_line(s)) != size_t(is_kept)){
+            throw runtime_error("FAIL: wrong S line for node " + std::to_string(graph.get_id(h)));
+        }
+        n_expected += is_kept;
+    });
+
+    graph.for_each_edge([&](const edge_t& e){
+        stringstream s;
+        write_edge_to_gfa(graph, e, s);
+
+        bool is_kept = not is_excluded(graph.get_id(e.first)) and not is_excluded(graph.get_id(e.second));
+        if (lines.count(to_line(s)) != size_t(is_kept)){
+            throw runtime_error("FAIL: wrong L line " + to_line(s));
+        }
+        n_expected += is_kept;
+    });
+
+    // The header, three nodes and the two edges between them
+    if (lines.size() != n_expected or n_expected != 6 or lines.count("H\tHVN:Z:1.0") == 0){
+        throw runtime_error("FAIL: unexpected lines in GFA with excluded nodes");
+    }
+
+    cerr << "PASS: excluded nodes and their edges are left out of the GFA" << endl;
+}
+
+
 int main(){
     string script_path = __FILE__;
     string project_directory = parent_path(script_path, 3);
@@ -42,6 +119,8 @@ int main(){
     ofstream out(output_path);
     handle_graph_to_gfa(g, out);
 
+    test_excluded_nodes();
+
     return 0;
 }
 
@@ -1,7 +1,11 @@
 #include <iostream>
+#include <atomic>
+#include <chrono>
 #include "utility.hpp"
 
 using std::cerr;
+using std::atomic;
+using std::chrono::milliseconds;
 using std::stoi;
 using bluntifier::join_paths;
 using bluntifier::parent_path;
@@ -9,6 +13,8 @@ using bluntifier::find_nth_instance;
 using bluntifier::trim_to_nth_instance;
 using bluntifier::find_nth_instance_from_back;
 using bluntifier::trim_to_nth_instance_from_back;
+using bluntifier::run_in_parallel;
+using bluntifier::start_parallel_workers;
 
 
 bool test_find_nth_instance(){
@@ -141,6 +147,60 @@ bool test_join_paths(){
 }
 
 
+bool test_run_in_parallel(){
+    atomic<size_t> n_running(0);
+    atomic<size_t> max_running(0);
+    atomic<size_t> n_calls(0);
+
+    auto work = [&](){
+        auto n = ++n_running;
+        auto m = max_running.load();
+        while (n > m and not max_running.compare_exchange_weak(m, n)){}
+
+        std::this_thread::sleep_for(milliseconds(20));
+
+        n_calls++;
+        n_running--;
+    };
+
+    // Loops nested in background workers or in another loop run on one thread each
+    vector<thread> workers;
+    start_parallel_workers(2, [&](){
+        run_in_parallel(4, work);
+    }, workers);
+
+    for (auto& worker: workers){
+        worker.join();
+    }
+
+    cerr << "Testing nested in background workers\n";
+    if (n_calls != 2 or max_running > 2){
+        return false;
+    }
+
+    run_in_parallel(3, [&](){
+        run_in_parallel(4, work);
+    });
+
+    cerr << "Testing nested in a parallel loop\n";
+    if (n_calls != 5 or max_running > 3){
+        return false;
+    }
+
+    // The calling thread is not left marked as a worker
+    n_calls = 0;
+    max_running = 0;
+    run_in_parallel(4, work);
+
+    cerr << "Testing unnested\n";
+    if (n_calls != 4 or max_running < 2){
+        return false;
+    }
+
+    return true;
+}
+
+
 int main(){
     bool pass;
 
@@ -168,6 +228,10 @@ int main(){
     if (not pass){
         throw runtime_error("FAIL: parent_path");
     }
+    pass = test_run_in_parallel();
+    if (not pass){
+        throw runtime_error("FAIL: run_in_parallel");
+    }
 
     cerr << "PASS\n";
 
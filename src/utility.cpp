@@ -4,6 +4,10 @@
 
 namespace bluntifier {
 
+// Set in every thread of a parallel loop
+static thread_local bool is_parallel_worker = false;
+
+
 void run_command(string& argument_string){
     int exit_code = system(argument_string.c_str());
 
@@ -128,5 +132,38 @@ string join_paths(string a, string b){
 }
 
 
+void run_in_parallel(size_t n_threads, const function<void()>& work){
+    if (is_parallel_worker or n_threads < 2){
+        work();
+        return;
+    }
+
+    vector<thread> workers;
+    for (size_t t = 1; t < n_threads; t++){
+        workers.emplace_back([&](){
+            is_parallel_worker = true;
+            work();
+        });
+    }
+
+    is_parallel_worker = true;
+    work();
+    is_parallel_worker = false;
+
+    for (auto& worker: workers){
+        worker.join();
+    }
+}
+
+
+void start_parallel_workers(size_t n_threads, const function<void()>& work, vector<thread>& workers){
+    for (size_t t = 0; t < n_threads; t++){
+        workers.emplace_back([work](){
+            is_parallel_worker = true;
+            work();
+        });
+    }
 }
 
+
+}